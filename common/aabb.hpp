@@ -0,0 +1,115 @@
+/**
+ * \file aabb.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The axis-aligned bounding box used by the acceleration structures.
+ */
+
+#ifndef AABB_HPP
+#define AABB_HPP
+
+#include "common.h"
+
+#include <cfloat>
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * An axis-aligned bounding box. The default one is empty, i.e., min > max,
+ * so that growing it with any point or box gives that point or box.
+ */
+class AABB
+{
+public:
+    vec3 min; /**< The lower corner. */
+    vec3 max; /**< The upper corner. */
+
+public:
+    AABB()
+        : min(FLT_MAX, FLT_MAX, FLT_MAX)
+        , max(-FLT_MAX, -FLT_MAX, -FLT_MAX)
+    {
+    }
+
+    AABB(const vec3 &lower, const vec3 &upper)
+        : min(lower)
+        , max(upper)
+    {
+    }
+    /**
+     * If the box contains nothing.
+     */
+    bool empty() const
+    {
+        return this->min.x > this->max.x || this->min.y > this->max.y || this->min.z > this->max.z;
+    }
+    /**
+     * Enlarge the box to enclose the given point.
+     */
+    void grow(const vec3 &p)
+    {
+        this->min.x = cy::Min(this->min.x, p.x);
+        this->min.y = cy::Min(this->min.y, p.y);
+        this->min.z = cy::Min(this->min.z, p.z);
+        this->max.x = cy::Max(this->max.x, p.x);
+        this->max.y = cy::Max(this->max.y, p.y);
+        this->max.z = cy::Max(this->max.z, p.z);
+    }
+    /**
+     * Enlarge the box to enclose another box.
+     */
+    void grow(const AABB &box)
+    {
+        this->min.x = cy::Min(this->min.x, box.min.x);
+        this->min.y = cy::Min(this->min.y, box.min.y);
+        this->min.z = cy::Min(this->min.z, box.min.z);
+        this->max.x = cy::Max(this->max.x, box.max.x);
+        this->max.y = cy::Max(this->max.y, box.max.y);
+        this->max.z = cy::Max(this->max.z, box.max.z);
+    }
+
+    vec3 extent() const { return this->max - this->min; }
+
+    vec3 centroid() const { return (this->min + this->max) * 0.5f; }
+    /**
+     * The surface area of the box. An empty box has zero area.
+     */
+    f32 area() const
+    {
+        if (this->empty())
+        {
+            return 0.0f;
+        }
+
+        vec3 e = this->extent();
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+    /**
+     * The slab test against a ray.
+     * @param origin the ray origin.
+     * @param invDirection the reciprocal of the ray direction.
+     * @param tmax the farthest distance along the ray that is of interest.
+     * @return true if the ray overlaps the box within [0, tmax].
+     */
+    bool intersect(const vec3 &origin, const vec3 &invDirection, f32 tmax) const noexcept
+    {
+        f32 tx0 = (this->min.x - origin.x) * invDirection.x;
+        f32 tx1 = (this->max.x - origin.x) * invDirection.x;
+        f32 ty0 = (this->min.y - origin.y) * invDirection.y;
+        f32 ty1 = (this->max.y - origin.y) * invDirection.y;
+        f32 tz0 = (this->min.z - origin.z) * invDirection.z;
+        f32 tz1 = (this->max.z - origin.z) * invDirection.z;
+
+        f32 tnear = cy::Max(cy::Min(tx0, tx1), cy::Min(ty0, ty1), cy::Min(tz0, tz1));
+        f32 tfar  = cy::Min(cy::Max(tx0, tx1), cy::Max(ty0, ty1), cy::Max(tz0, tz1));
+
+        return tnear <= tfar && tfar >= 0.0f && tnear <= tmax;
+    }
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !AABB_HPP
@@ -0,0 +1,107 @@
+/**
+ * \file arena.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The monotonic memory arena.
+ */
+
+#include "arena.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+CS6620_NAMESPACE_BEGIN
+
+// The block header keeps the data after it aligned for anything.
+static const size_t BLOCK_HEADER_SIZE = (sizeof(void *) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+Arena::Arena(size_t blockSize)
+    : _blockSize(blockSize)
+{
+}
+
+Arena::~Arena()
+{
+    this->release();
+}
+
+void *Arena::allocate(size_t size, size_t alignment) noexcept
+{
+    ++this->_stats.allocations;
+    this->_stats.bytes += size;
+
+    u8 *p = (u8 *)(((uintptr_t)this->_current + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    if (this->_current != nullptr && p + size <= this->_end)
+    {
+        this->_current = p + size;
+        return p;
+    }
+
+    // A big piece gets a block of its own, so the free space of the current
+    // block isn't wasted.
+    if (size > this->_blockSize / 4)
+    {
+        return this->_allocateBlock(size);
+    }
+
+    p = (u8 *)this->_allocateBlock(this->_blockSize);
+    this->_current = p + size;
+    this->_end = p + this->_blockSize;
+    return p;
+}
+
+const char *Arena::copy(const char *s) noexcept
+{
+    if (s == nullptr)
+    {
+        s = "";
+    }
+
+    size_t size = strlen(s) + 1;
+    char *copied = (char *)this->allocate(size, 1);
+    memcpy(copied, s, size);
+    return copied;
+}
+
+void Arena::release() noexcept
+{
+    for (Destructor *destructor = this->_destructors; destructor != nullptr; destructor = destructor->next)
+    {
+        destructor->destroy(destructor->object);
+    }
+    this->_destructors = nullptr;
+
+    while (this->_blocks != nullptr)
+    {
+        Block *next = this->_blocks->next;
+        free(this->_blocks);
+        this->_blocks = next;
+    }
+
+    this->_current = nullptr;
+    this->_end = nullptr;
+    this->_stats = Stats();
+}
+
+void *Arena::_allocateBlock(size_t size) noexcept
+{
+    Block *block = (Block *)malloc(BLOCK_HEADER_SIZE + size);
+    if (block == nullptr)
+    {
+        LOG(FATAL) << "Out of memory allocating a block of " << size << " bytes.";
+        return nullptr;
+    }
+
+    block->next = this->_blocks;
+    this->_blocks = block;
+
+    ++this->_stats.blocks;
+    this->_stats.reservedBytes += size;
+
+    return (u8 *)block + BLOCK_HEADER_SIZE;
+}
+
+CS6620_NAMESPACE_END
@@ -0,0 +1,164 @@
+/**
+ * \file arena.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The monotonic memory arena.
+ */
+
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include "common.h"
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * Hand out memory by bumping a pointer through large blocks and free it all
+ * at once. The objects created in it are destroyed in the reverse order of
+ * creation when it's released, and the memory is never given back one piece
+ * at a time.
+ *
+ * Not thread safe.
+ */
+class Arena
+{
+public:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Stats
+    {
+        u64 allocations;    /**< The pieces handed out, each of which would be a heap allocation otherwise. */
+        u64 blocks;         /**< The heap allocations actually made. */
+        u64 bytes;          /**< The bytes handed out. */
+        u64 reservedBytes;  /**< The bytes of the blocks. */
+        u64 destructors;    /**< The objects to destroy on release. */
+    };
+
+public:
+    /**
+     * Constructor.
+     * @param blockSize the size of a block. Bigger allocations get a block
+     * of their own.
+     */
+    explicit Arena(size_t blockSize = BLOCK_SIZE);
+    /**
+     * Destructor. Release everything.
+     */
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    /**
+     * Allocate uninitialized memory.
+     * @param size the size in bytes.
+     * @param alignment a power of two no more than alignof(std::max_align_t).
+     * @return the memory, which lives until release().
+     */
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t)) noexcept;
+    /**
+     * Construct an object in the arena. Its destructor runs on release()
+     * unless it's trivial.
+     */
+    template <typename T, typename... Args>
+    T *create(Args &&...args);
+    /**
+     * Copy a zero terminated string into the arena. nullptr becomes "".
+     */
+    const char *copy(const char *s) noexcept;
+    /**
+     * Destroy the objects and free all the blocks.
+     */
+    void release() noexcept;
+
+    Stats stats() const { return this->_stats; }
+
+private:
+    struct Block
+    {
+        Block *next;
+    };
+
+    struct Destructor
+    {
+        void      (*destroy)(void *);
+        void       *object;
+        Destructor *next;
+    };
+
+    template <typename T>
+    static void _Destroy(void *object) { static_cast<T *>(object)->~T(); }
+
+    void *_allocateBlock(size_t size) noexcept;
+
+private:
+    size_t      _blockSize;
+    Block      *_blocks = nullptr;      /**< All the blocks. */
+    u8         *_current = nullptr;     /**< The free space in the current block. */
+    u8         *_end = nullptr;
+    Destructor *_destructors = nullptr; /**< The objects to destroy, the latest first. */
+    Stats       _stats = {};
+};
+
+template <typename T, typename... Args>
+T *Arena::create(Args &&...args)
+{
+    void *memory = this->allocate(sizeof(T), alignof(T));
+    T *object = new (memory) T(std::forward<Args>(args)...);
+
+    if (!std::is_trivially_destructible<T>::value)
+    {
+        Destructor *destructor = static_cast<Destructor *>(this->allocate(sizeof(Destructor), alignof(Destructor)));
+        destructor->destroy = &Arena::_Destroy<T>;
+        destructor->object = object;
+        destructor->next = this->_destructors;
+        this->_destructors = destructor;
+        ++this->_stats.destructors;
+    }
+
+    return object;
+}
+
+/**
+ * The standard allocator on an arena, so the containers of the objects in
+ * the arena live there too. Deallocation does nothing, as the memory is
+ * freed along with the arena.
+ */
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+public:
+    explicit ArenaAllocator(Arena *arena) : _arena(arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : _arena(other.arena()) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(this->_arena->allocate(n * sizeof(T), alignof(T))); }
+
+    void deallocate(T *, size_t) {}
+
+    Arena *arena() const { return this->_arena; }
+
+private:
+    Arena *_arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() == b.arena(); }
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() != b.arena(); }
+
+CS6620_NAMESPACE_END
+
+
+#endif // !ARENA_HPP
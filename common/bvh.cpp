@@ -0,0 +1,1440 @@
+/**
+ * \file bvh.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The bounding volume hierarchy over a set of primitive bounds.
+ */
+
+#include "bvh.hpp"
+
+#include "arena.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+CS6620_NAMESPACE_BEGIN
+
+// The relative costs of a traversal step and a primitive test in the SAH.
+static const f32 TRAVERSAL_COST = 1.0f;
+static const f32 INTERSECTION_COST = 1.0f;
+
+// The bins along each axis of the binned SAH.
+static const u32 NUM_BINS = 32;
+// The binned build switches to the full sweep at this many primitives.
+static const u32 SWEEP_SIZE = 32;
+// The least primitives of a subtree task, and how many tasks each thread
+// gets so that the work stealing can even out their uneven sizes.
+static const u32 MIN_TASK_SIZE = 4096;
+static const u32 TASKS_PER_THREAD = 8;
+// The least primitives binned by a task of a top-level split.
+static const u32 MIN_CHUNK_SIZE = 16384;
+// The linear BVH switches from the 30-bit Morton codes to the 63-bit ones,
+// which tell apart the centroids on a finer grid but take twice the radix
+// sort passes, at this many primitives.
+static const u32 MORTON_63_SIZE = 1u << 18;
+// The digit of a radix sort pass.
+static const u32 RADIX_BITS = 8;
+static const u32 RADIX = 1u << RADIX_BITS;
+// The leaves of a treelet to reorder. Finding its best topology takes
+// about 3^n steps.
+static const u32 TREELET_SIZE = 7;
+
+/**
+ * Run job(task, thread) for all tasks on the pool, or on the calling thread
+ * as thread 0 without one.
+ */
+template <typename F>
+static void _Run(ThreadPool *pool, u32 numTasks, F &&job)
+{
+    if (pool != nullptr && numTasks > 1)
+    {
+        pool->run(numTasks, job);
+    }
+    else
+    {
+        for (u32 task = 0; task < numTasks; ++task)
+        {
+            job(task, 0);
+        }
+    }
+}
+
+/**
+ * The number of chunks to go through the primitives in parallel.
+ */
+static u32 _NumChunks(u32 count, ThreadPool *pool)
+{
+    if (pool == nullptr)
+    {
+        return 1;
+    }
+    return cy::Min(pool->size() * 4, cy::Max(count / MIN_CHUNK_SIZE, 1u));
+}
+
+/**
+ * The smallest n with 2^n >= x.
+ */
+static u32 _CeilLog2(u32 x)
+{
+    u32 n = 0;
+    while (((u64)1 << n) < x)
+    {
+        ++n;
+    }
+    return n;
+}
+
+/**
+ * The index of the lowest set bit.
+ */
+static u32 _LowestBit(u32 x)
+{
+    u32 n = 0;
+    while ((x >> n & 1) == 0)
+    {
+        ++n;
+    }
+    return n;
+}
+
+/**
+ * The Morton codes of the given width, which interleave the bits of the
+ * quantized x, y and z with x the highest.
+ */
+template <typename Code>
+struct _Morton;
+
+template <>
+struct _Morton<u32>
+{
+    static const u32 BITS = 10; /**< Per axis. */
+
+    /**
+     * Spread the bits two zeros apart.
+     */
+    static u32 expand(u32 v)
+    {
+        v = (v | (v << 16)) & 0x030000ffu;
+        v = (v | (v << 8)) & 0x0300f00fu;
+        v = (v | (v << 4)) & 0x030c30c3u;
+        v = (v | (v << 2)) & 0x09249249u;
+        return v;
+    }
+};
+
+template <>
+struct _Morton<u64>
+{
+    static const u32 BITS = 21; /**< Per axis. */
+
+    /**
+     * Spread the bits two zeros apart.
+     */
+    static u64 expand(u64 v)
+    {
+        v = (v | (v << 32)) & 0x001f00000000ffffull;
+        v = (v | (v << 16)) & 0x001f0000ff0000ffull;
+        v = (v | (v << 8)) & 0x100f00f00f00f00full;
+        v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+        v = (v | (v << 2)) & 0x1249249249249249ull;
+        return v;
+    }
+};
+
+/**
+ * Sort the codes together with their values by the least significant digit
+ * first radix sort. Each pass counts the digits of a chunk per task and
+ * then scatters the chunks in order, so every pass is stable. The passes
+ * whose digits are all the same are skipped.
+ * @param bits the low bits of the codes in use.
+ */
+template <typename Code>
+static void _RadixSort(std::vector<Code> &codes, std::vector<u32> &values, u32 bits, ThreadPool *pool)
+{
+    u32 n = (u32)codes.size();
+    std::vector<Code> sortedCodes(n);
+    std::vector<u32> sortedValues(n);
+
+    u32 numChunks = _NumChunks(n, pool);
+    std::vector<u32> offsets(numChunks * RADIX);
+    for (u32 shift = 0; shift < bits; shift += RADIX_BITS)
+    {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        _Run(pool, numChunks, [&](u32 chunk, u32)
+        {
+            u32 begin = (u32)((u64)n * chunk / numChunks);
+            u32 end = (u32)((u64)n * (chunk + 1) / numChunks);
+            u32 *counts = &offsets[chunk * RADIX];
+            for (u32 i = begin; i < end; ++i)
+            {
+                ++counts[(codes[i] >> shift) & (RADIX - 1)];
+            }
+        });
+
+        bool sorted = false;
+        for (u32 digit = 0; digit < RADIX && !sorted; ++digit)
+        {
+            u32 count = 0;
+            for (u32 chunk = 0; chunk < numChunks; ++chunk)
+            {
+                count += offsets[chunk * RADIX + digit];
+            }
+            sorted = count == n;
+        }
+        if (sorted)
+        {
+            continue;
+        }
+
+        // Where each chunk puts its first code of each digit.
+        u32 sum = 0;
+        for (u32 digit = 0; digit < RADIX; ++digit)
+        {
+            for (u32 chunk = 0; chunk < numChunks; ++chunk)
+            {
+                u32 count = offsets[chunk * RADIX + digit];
+                offsets[chunk * RADIX + digit] = sum;
+                sum += count;
+            }
+        }
+
+        _Run(pool, numChunks, [&](u32 chunk, u32)
+        {
+            u32 begin = (u32)((u64)n * chunk / numChunks);
+            u32 end = (u32)((u64)n * (chunk + 1) / numChunks);
+            u32 *next = &offsets[chunk * RADIX];
+            for (u32 i = begin; i < end; ++i)
+            {
+                u32 j = next[(codes[i] >> shift) & (RADIX - 1)]++;
+                sortedCodes[j] = codes[i];
+                sortedValues[j] = values[i];
+            }
+        });
+
+        codes.swap(sortedCodes);
+        values.swap(sortedValues);
+    }
+}
+
+/**
+ * Split the primitives with the sorted Morton codes [begin, end) where the
+ * highest bit they differ at flips, i.e., at the plane halving the grid
+ * cell they share. Fall back to the middle if their codes are all the
+ * same, or if a side could get too deep for the traversal stack, which a
+ * middle split never does as long as depth + log2(count) stays within it.
+ * @param inout_bit the highest bit the codes may differ at. Lowered to the
+ * one for the sides.
+ * @param out_axis return the axis of the split plane.
+ * @return the first primitive on the right.
+ */
+template <typename Code>
+static u32 _MortonSplit(const Code *codes, u32 begin, u32 end, u32 depth, u32 &inout_bit, u16 &out_axis)
+{
+    u32 middle = begin + (end - begin) / 2;
+    out_axis = 0;
+
+    Code diff = codes[begin] ^ codes[end - 1];
+    if (diff == 0)
+    {
+        return middle;
+    }
+
+    u32 bit = inout_bit;
+    while ((diff >> bit & 1) == 0)
+    {
+        --bit;
+    }
+    Code mask = (Code)1 << bit;
+    u32 split = (u32)(std::partition_point(codes + begin, codes + end, [mask](Code code) { return (code & mask) == 0; }) - codes);
+    out_axis = (u16)(2 - bit % 3);
+
+    if (depth + 1 + _CeilLog2(cy::Max(split - begin, end - split)) > BVH::MAX_DEPTH)
+    {
+        inout_bit = bit;
+        return middle;
+    }
+
+    inout_bit = bit > 0 ? bit - 1 : 0;
+    return split;
+}
+
+/**
+ * Find the lowest SAH cost topology of the treelet under an interior node,
+ * i.e., the node with its largest descendants opened until it has
+ * TREELET_SIZE leaves, by going through all partitions of all subsets of
+ * the leaves. Relink the interior nodes of the treelet into it if it's
+ * cheaper. The leaves keep their subtrees.
+ * @param left the first child of each node.
+ * @param right the second child of each node.
+ * @param costs the SAH cost of each subtree, not normalized by any area.
+ */
+static void _ReorderTreelet(u32 root, BVHNode *nodes, u32 *left, u32 *right, f32 *costs)
+{
+    u32 leaves[TREELET_SIZE];
+    u32 interiors[TREELET_SIZE - 1];
+    u32 numLeaves = 0;
+    u32 numInteriors = 0;
+
+    leaves[numLeaves++] = left[root];
+    leaves[numLeaves++] = right[root];
+    interiors[numInteriors++] = root;
+
+    while (numLeaves < TREELET_SIZE)
+    {
+        i32 largest = -1;
+        f32 largestArea = -FLT_MAX;
+        for (u32 i = 0; i < numLeaves; ++i)
+        {
+            const BVHNode &leaf = nodes[leaves[i]];
+            if (!leaf.leaf() && leaf.bounds.area() > largestArea)
+            {
+                largest = (i32)i;
+                largestArea = leaf.bounds.area();
+            }
+        }
+        if (largest < 0)
+        {
+            break;
+        }
+
+        u32 opened = leaves[largest];
+        interiors[numInteriors++] = opened;
+        leaves[largest] = left[opened];
+        leaves[numLeaves++] = right[opened];
+    }
+
+    if (numLeaves < 3)
+    {
+        return;
+    }
+
+    // The subsets are numbered by the bits of their leaves, so the subsets
+    // of a subset come before it.
+    const u32 NUM_SUBSETS = 1u << TREELET_SIZE;
+    AABB bounds[NUM_SUBSETS];
+    f32 best[NUM_SUBSETS];
+    u32 splits[NUM_SUBSETS];
+
+    u32 all = (1u << numLeaves) - 1;
+    for (u32 subset = 1; subset <= all; ++subset)
+    {
+        if ((subset & (subset - 1)) == 0)
+        {
+            u32 leaf = leaves[_LowestBit(subset)];
+            bounds[subset] = nodes[leaf].bounds;
+            best[subset] = costs[leaf];
+            continue;
+        }
+
+        u32 lowest = subset & (~subset + 1);
+        bounds[subset] = bounds[lowest];
+        bounds[subset].grow(bounds[subset ^ lowest]);
+
+        // The sides are interchangeable, so only the left ones with the
+        // lowest leaf are tried.
+        f32 bestCost = FLT_MAX;
+        u32 bestSplit = 0;
+        for (u32 side = (subset - 1) & subset; side != 0; side = (side - 1) & subset)
+        {
+            if ((side & lowest) == 0)
+            {
+                continue;
+            }
+
+            f32 cost = best[side] + best[subset ^ side];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = side;
+            }
+        }
+
+        best[subset] = TRAVERSAL_COST * bounds[subset].area() + bestCost;
+        splits[subset] = bestSplit;
+    }
+
+    // Leave it alone unless it gets clearly cheaper, so rounding doesn't
+    // shuffle the equal ones.
+    if (best[all] >= costs[root] * 0.9999f)
+    {
+        return;
+    }
+
+    // Relink the interior nodes top down. The root stays where its parent
+    // links to.
+    struct Entry
+    {
+        u32 subset;
+        u32 node;
+    };
+    Entry stack[TREELET_SIZE];
+    u32 top = 0;
+    u32 nextInterior = 1;
+
+    stack[top++] = Entry{all, root};
+    while (top > 0)
+    {
+        Entry entry = stack[--top];
+
+        u32 sides[2] = {splits[entry.subset], entry.subset ^ splits[entry.subset]};
+        u32 children[2];
+        for (u32 k = 0; k < 2; ++k)
+        {
+            if ((sides[k] & (sides[k] - 1)) == 0)
+            {
+                children[k] = leaves[_LowestBit(sides[k])];
+            }
+            else
+            {
+                children[k] = interiors[nextInterior++];
+                stack[top++] = Entry{sides[k], children[k]};
+            }
+        }
+
+        // The traversal takes the first child as the lower one along the
+        // axis, so split along the one the children are the farthest apart.
+        vec3 apart = bounds[sides[1]].centroid() - bounds[sides[0]].centroid();
+        u16 axis = 0;
+        for (u16 i = 1; i < 3; ++i)
+        {
+            if (fabsf(apart[i]) > fabsf(apart[axis]))
+            {
+                axis = i;
+            }
+        }
+        if (apart[axis] < 0.0f)
+        {
+            std::swap(children[0], children[1]);
+        }
+
+        BVHNode &node = nodes[entry.node];
+        node.bounds = bounds[entry.subset];
+        node.axis = axis;
+        left[entry.node] = children[0];
+        right[entry.node] = children[1];
+        costs[entry.node] = best[entry.subset];
+    }
+}
+
+/**
+ * Map the centroids to the bins evenly spaced over their bounds.
+ */
+struct _Binning
+{
+    vec3 origin;
+    vec3 scale; /**< 0 along an axis the centroids don't spread over. */
+
+    explicit _Binning(const AABB &centroidBounds)
+        : origin(centroidBounds.min)
+    {
+        vec3 extent = centroidBounds.extent();
+        for (i32 axis = 0; axis < 3; ++axis)
+        {
+            f32 scale = extent[axis] > 0.0f ? (f32)NUM_BINS / extent[axis] : 0.0f;
+            this->scale[axis] = scale < FLT_MAX ? scale : 0.0f;
+        }
+    }
+
+    u32 bin(const vec3 &centroid, i32 axis) const
+    {
+        return (u32)cy::Min((centroid[axis] - this->origin[axis]) * this->scale[axis], (f32)(NUM_BINS - 1));
+    }
+};
+
+/**
+ * The chosen split between two bins and the bounds on both sides of it.
+ */
+struct _Split
+{
+    i32  axis = -1;      /**< -1 if none is found. */
+    u32  bin = 0;        /**< The first bin on the right. */
+    f32  cost = FLT_MAX; /**< The unnormalized SAH cost. */
+    u32  leftCount = 0;
+    AABB leftBounds;
+    AABB leftCentroidBounds;
+    AABB rightBounds;
+    AABB rightCentroidBounds;
+};
+
+/**
+ * Partition the primitives by the split. If there is none, i.e., all
+ * centroids coincide, split them in the middle as the SAH can't help and
+ * fill the bounds of the split in.
+ * @return the first primitive on the right.
+ */
+static u32 _Partition(u32 *indices, const vec3 *centroids, const AABB *primitiveBounds, u32 begin, u32 end,
+    const _Binning &binning, _Split &inout_split)
+{
+    if (inout_split.axis >= 0)
+    {
+        i32 axis = inout_split.axis;
+        u32 bin = inout_split.bin;
+        u32 *middle = std::partition(indices + begin, indices + end,
+            [&](u32 i) { return binning.bin(centroids[i], axis) < bin; });
+
+        assert((u32)(middle - indices) == begin + inout_split.leftCount);
+        return (u32)(middle - indices);
+    }
+
+    u32 middle = begin + (end - begin) / 2;
+    inout_split.axis = 0;
+    for (u32 i = begin; i < middle; ++i)
+    {
+        inout_split.leftBounds.grow(primitiveBounds[indices[i]]);
+        inout_split.leftCentroidBounds.grow(centroids[indices[i]]);
+    }
+    for (u32 i = middle; i < end; ++i)
+    {
+        inout_split.rightBounds.grow(primitiveBounds[indices[i]]);
+        inout_split.rightCentroidBounds.grow(centroids[indices[i]]);
+    }
+    return middle;
+}
+
+/**
+ * The bins of all three axes.
+ */
+struct BVH::_Bins
+{
+    struct Bin
+    {
+        AABB bounds;
+        AABB centroidBounds;
+        u32  count;
+    };
+
+    Bin bins[3][NUM_BINS];
+
+    _Bins() { this->clear(); }
+
+    void clear()
+    {
+        for (i32 axis = 0; axis < 3; ++axis)
+        {
+            for (u32 k = 0; k < NUM_BINS; ++k)
+            {
+                this->bins[axis][k] = Bin{AABB(), AABB(), 0};
+            }
+        }
+    }
+    /**
+     * Put the primitives [begin, end) into the bins.
+     */
+    void add(const u32 *indices, const vec3 *centroids, const AABB *primitiveBounds, u32 begin, u32 end, const _Binning &binning)
+    {
+        for (u32 i = begin; i < end; ++i)
+        {
+            u32 index = indices[i];
+            for (i32 axis = 0; axis < 3; ++axis)
+            {
+                Bin &bin = this->bins[axis][binning.bin(centroids[index], axis)];
+                bin.bounds.grow(primitiveBounds[index]);
+                bin.centroidBounds.grow(centroids[index]);
+                ++bin.count;
+            }
+        }
+    }
+    /**
+     * Add the bins of another part of the same primitives.
+     */
+    void merge(const _Bins &other)
+    {
+        for (i32 axis = 0; axis < 3; ++axis)
+        {
+            for (u32 k = 0; k < NUM_BINS; ++k)
+            {
+                this->bins[axis][k].bounds.grow(other.bins[axis][k].bounds);
+                this->bins[axis][k].centroidBounds.grow(other.bins[axis][k].centroidBounds);
+                this->bins[axis][k].count += other.bins[axis][k].count;
+            }
+        }
+    }
+    /**
+     * Sweep the bins along each axis and find the cheapest split.
+     */
+    _Split split(const _Binning &binning) const
+    {
+        _Split best;
+        for (i32 axis = 0; axis < 3; ++axis)
+        {
+            if (binning.scale[axis] <= 0.0f)
+            {
+                continue;
+            }
+
+            const Bin *axisBins = this->bins[axis];
+
+            f32 rightAreas[NUM_BINS];
+            u32 rightCounts[NUM_BINS];
+            AABB right;
+            u32 rightCount = 0;
+            for (u32 k = NUM_BINS - 1; k > 0; --k)
+            {
+                right.grow(axisBins[k].bounds);
+                rightCount += axisBins[k].count;
+                rightAreas[k] = right.area();
+                rightCounts[k] = rightCount;
+            }
+
+            AABB left;
+            u32 leftCount = 0;
+            for (u32 k = 1; k < NUM_BINS; ++k)
+            {
+                left.grow(axisBins[k - 1].bounds);
+                leftCount += axisBins[k - 1].count;
+                if (leftCount == 0 || rightCounts[k] == 0)
+                {
+                    continue;
+                }
+
+                f32 cost = left.area() * (f32)leftCount + rightAreas[k] * (f32)rightCounts[k];
+                if (cost < best.cost)
+                {
+                    best.axis = axis;
+                    best.bin = k;
+                    best.cost = cost;
+                    best.leftCount = leftCount;
+                }
+            }
+        }
+
+        if (best.axis >= 0)
+        {
+            for (u32 k = 0; k < NUM_BINS; ++k)
+            {
+                const Bin &bin = this->bins[best.axis][k];
+                AABB &bounds = k < best.bin ? best.leftBounds : best.rightBounds;
+                AABB &centroidBounds = k < best.bin ? best.leftCentroidBounds : best.rightCentroidBounds;
+                bounds.grow(bin.bounds);
+                centroidBounds.grow(bin.centroidBounds);
+            }
+        }
+        return best;
+    }
+};
+
+/**
+ * A node of the top levels of the binned build.
+ */
+struct BVH::_TopNode
+{
+    u32 second; /**< The second child in the top nodes. */
+    u16 axis;
+    i32 task;   /**< The subtree task under it, or -1 if it's split further. */
+};
+
+/**
+ * A subtree of the binned build left to a task.
+ */
+struct BVH::_Task
+{
+    u32            begin;
+    u32            end;
+    u32            depth;
+    AABB           bounds;
+    AABB           centroidBounds;
+    const BVHNode *nodes;    /**< The built nodes, linked relative to the first. */
+    u32            numNodes;
+    u32            maxDepth;
+};
+
+bool ParseBVHBuilder(const char *name, BVHBuilder &out_builder)
+{
+    if (strcmp(name, "sah") == 0)
+    {
+        out_builder = BVHBuilder::SAH;
+    }
+    else if (strcmp(name, "lbvh") == 0)
+    {
+        out_builder = BVHBuilder::LBVH;
+    }
+    else if (strcmp(name, "lbvh-treelet") == 0)
+    {
+        out_builder = BVHBuilder::LBVH_TREELET;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+BVH::BVH()
+{
+}
+
+BVH::~BVH()
+{
+}
+
+void BVH::build(const std::vector<AABB> &primitiveBounds, u32 maxLeafSize) noexcept
+{
+    CS6620_PROFILE_SCOPE("BVH build");
+
+    u32 numPrimitives = (u32)primitiveBounds.size();
+    this->_begin(primitiveBounds, maxLeafSize);
+    if (numPrimitives == 0)
+    {
+        this->_end();
+        return;
+    }
+
+    this->_rightAreas.resize(numPrimitives);
+    for (u32 i = 0; i < numPrimitives; ++i)
+    {
+        this->_centroids[i] = primitiveBounds[i].centroid();
+        this->_indices[i] = i;
+    }
+
+    // A binary tree has at most 2n - 1 nodes.
+    this->_nodes.resize(2 * numPrimitives - 1);
+
+    _Nodes nodes = {this->_nodes.data(), 0, 0};
+    this->_build(nodes, 0, numPrimitives, 1);
+
+    this->_nodes.resize(nodes.size);
+    this->_depth = nodes.depth;
+
+    this->_end();
+}
+
+void BVH::buildBinned(const std::vector<AABB> &primitiveBounds, u32 maxLeafSize, ThreadPool *pool) noexcept
+{
+    CS6620_PROFILE_SCOPE("BVH build");
+
+    Timer timer;
+
+    u32 numPrimitives = (u32)primitiveBounds.size();
+    this->_begin(primitiveBounds, maxLeafSize);
+    if (numPrimitives == 0)
+    {
+        this->_end();
+        return;
+    }
+
+    this->_rightAreas.resize(numPrimitives);
+
+    u32 numThreads = pool != nullptr ? pool->size() : 1;
+    std::unique_ptr<Arena[]> arenas(new Arena[numThreads]);
+
+    // The centroids and the bounds of everything, a chunk per task.
+    u32 numChunks = _NumChunks(numPrimitives, pool);
+    std::vector<AABB> chunkBounds(numChunks);
+    std::vector<AABB> chunkCentroidBounds(numChunks);
+    _Run(pool, numChunks, [&](u32 chunk, u32)
+    {
+        u32 begin = (u32)((u64)numPrimitives * chunk / numChunks);
+        u32 end = (u32)((u64)numPrimitives * (chunk + 1) / numChunks);
+        for (u32 i = begin; i < end; ++i)
+        {
+            this->_centroids[i] = primitiveBounds[i].centroid();
+            this->_indices[i] = i;
+            chunkBounds[chunk].grow(primitiveBounds[i]);
+            chunkCentroidBounds[chunk].grow(this->_centroids[i]);
+        }
+    });
+
+    AABB bounds;
+    AABB centroidBounds;
+    for (u32 chunk = 0; chunk < numChunks; ++chunk)
+    {
+        bounds.grow(chunkBounds[chunk]);
+        centroidBounds.grow(chunkCentroidBounds[chunk]);
+    }
+
+    // Enough subtrees for the work stealing to even them out.
+    u32 taskSize = cy::Max(numPrimitives / (numThreads * TASKS_PER_THREAD), MIN_TASK_SIZE);
+
+    std::vector<_TopNode> top;
+    std::vector<_Task> tasks;
+    this->_splitTop(top, tasks, 0, numPrimitives, bounds, centroidBounds, 1, taskSize, pool, arenas.get());
+
+    // Each task builds into a buffer from the arena of its thread, which
+    // holds the worst case of 2n - 1 nodes.
+    _Run(pool, (u32)tasks.size(), [&](u32 index, u32 thread)
+    {
+        _Task &task = tasks[index];
+        u32 count = task.end - task.begin;
+
+        BVHNode *data = (BVHNode *)arenas[thread].allocate((2 * count - 1) * sizeof(BVHNode), alignof(BVHNode));
+        _Bins *bins = arenas[thread].create<_Bins>();
+        _Nodes nodes = {data, 0, 0};
+        this->_buildBinned(nodes, *bins, task.begin, task.end, task.bounds, task.centroidBounds, task.depth);
+
+        task.nodes = data;
+        task.numNodes = nodes.size;
+        task.maxDepth = nodes.depth;
+    });
+
+    this->_nodes.reserve(2 * numPrimitives - 1);
+    this->_emit(top, tasks, 0);
+
+    // The subtrees are the deepest parts.
+    for (const _Task &task : tasks)
+    {
+        this->_depth = cy::Max(this->_depth, task.maxDepth);
+    }
+
+    this->_end();
+
+    f64 seconds = timer.elapsed();
+    LOG(INFO) << "Binned SAH BVH over " << numPrimitives << " primitives built in " << seconds * 1000.0 << " ms on "
+        << numThreads << " threads, " << numPrimitives / seconds * 1e-6 << " Mprims/s.";
+}
+
+void BVH::buildLinear(const std::vector<AABB> &primitiveBounds, u32 maxLeafSize, ThreadPool *pool, bool optimizeTreelets) noexcept
+{
+    CS6620_PROFILE_SCOPE("BVH build");
+
+    Timer timer;
+
+    u32 numPrimitives = (u32)primitiveBounds.size();
+    this->_begin(primitiveBounds, maxLeafSize);
+    if (numPrimitives == 0)
+    {
+        this->_end();
+        return;
+    }
+
+    assert(this->_maxLeafSize <= 0xffff);
+
+    if (numPrimitives < MORTON_63_SIZE)
+    {
+        this->_buildLinear<u32>(pool, optimizeTreelets);
+    }
+    else
+    {
+        this->_buildLinear<u64>(pool, optimizeTreelets);
+    }
+
+    this->_end();
+
+    f64 seconds = timer.elapsed();
+    LOG(INFO) << "LBVH " << (optimizeTreelets ? "with reordered treelets " : "") << "over " << numPrimitives
+        << " primitives built in " << seconds * 1000.0 << " ms on " << (pool != nullptr ? pool->size() : 1)
+        << " threads, " << numPrimitives / seconds * 1e-6 << " Mprims/s.";
+}
+
+void BVH::map(const BVHNode *nodes, u32 numNodes, const u32 *indices, u32 numIndices, u32 depth, std::shared_ptr<const void> owner) noexcept
+{
+    if (nodes != nullptr)
+    {
+        std::vector<BVHNode>().swap(this->_nodes);
+        std::vector<u32>().swap(this->_indices);
+        this->_depth = depth;
+    }
+
+    this->_mappedNodes = nodes;
+    this->_mappedIndices = indices;
+    this->_numMappedNodes = numNodes;
+    this->_numMappedIndices = numIndices;
+    this->_mapping = owner;
+}
+
+void BVH::refit(const std::vector<AABB> &primitiveBounds) noexcept
+{
+    assert(primitiveBounds.size() == this->numIndices());
+
+    if (this->_mappedNodes != nullptr)
+    {
+        std::vector<BVHNode> nodes(this->_mappedNodes, this->_mappedNodes + this->_numMappedNodes);
+        std::vector<u32> indices(this->_mappedIndices, this->_mappedIndices + this->_numMappedIndices);
+
+        this->map(nullptr, 0, nullptr, 0, 0, nullptr);
+        this->_nodes.swap(nodes);
+        this->_indices.swap(indices);
+    }
+
+    // The children always come after their parent, so a backward pass sees
+    // them fit before it.
+    BVHNode *nodes = this->_nodes.data();
+    for (u32 i = (u32)this->_nodes.size(); i-- > 0;)
+    {
+        BVHNode &node = nodes[i];
+        if (node.leaf())
+        {
+            node.bounds = AABB();
+            for (u32 j = node.offset; j < node.offset + node.count; ++j)
+            {
+                node.bounds.grow(primitiveBounds[this->_indices[j]]);
+            }
+        }
+        else
+        {
+            node.bounds = nodes[i + 1].bounds;
+            node.bounds.grow(nodes[node.offset].bounds);
+        }
+    }
+}
+
+f32 BVH::sahCost() const noexcept
+{
+    const BVHNode *nodes = this->nodes();
+    u32 numNodes = this->numNodes();
+    if (numNodes == 0)
+    {
+        return 0.0f;
+    }
+
+    f64 cost = 0.0;
+    for (u32 i = 0; i < numNodes; ++i)
+    {
+        const BVHNode &node = nodes[i];
+        if (node.leaf())
+        {
+            cost += INTERSECTION_COST * node.bounds.area() * (f64)node.count;
+        }
+        else
+        {
+            cost += TRAVERSAL_COST * node.bounds.area();
+        }
+    }
+
+    f32 rootArea = nodes[0].bounds.area();
+    return rootArea > 0.0f ? (f32)(cost / rootArea) : 0.0f;
+}
+
+void BVH::_begin(const std::vector<AABB> &primitiveBounds, u32 maxLeafSize) noexcept
+{
+    this->_nodes.clear();
+    this->_indices.clear();
+    this->_depth = 0;
+    this->map(nullptr, 0, nullptr, 0, 0, nullptr);
+
+    u32 numPrimitives = (u32)primitiveBounds.size();
+
+    this->_primitiveBounds = &primitiveBounds;
+    this->_maxLeafSize = cy::Max(maxLeafSize, 1u);
+
+    this->_centroids.resize(numPrimitives);
+    this->_indices.resize(numPrimitives);
+}
+
+void BVH::_end() noexcept
+{
+    this->_nodes.shrink_to_fit();
+
+    this->_primitiveBounds = nullptr;
+    std::vector<vec3>().swap(this->_centroids);
+    std::vector<f32>().swap(this->_rightAreas);
+}
+
+bool BVH::validate(const BVHNode *nodes, u32 numNodes, u32 numIndices) noexcept
+{
+    // The children always come after their parent.
+    std::vector<u32> depths(numNodes, 1);
+    for (u32 i = 0; i < numNodes; ++i)
+    {
+        const BVHNode &node = nodes[i];
+        if (depths[i] > MAX_DEPTH)
+        {
+            return false;
+        }
+
+        if (node.leaf())
+        {
+            if ((u64)node.offset + node.count > numIndices)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (node.offset <= i + 1 || node.offset >= numNodes || node.axis > 2)
+            {
+                return false;
+            }
+            depths[i + 1] = cy::Max(depths[i + 1], depths[i] + 1);
+            depths[node.offset] = cy::Max(depths[node.offset], depths[i] + 1);
+        }
+    }
+    return true;
+}
+
+u32 BVH::_build(_Nodes &nodes, u32 begin, u32 end, u32 depth) noexcept
+{
+    const std::vector<AABB> &primitiveBounds = *this->_primitiveBounds;
+
+    u32 nodeIndex = nodes.size++;
+    nodes.depth = cy::Max(nodes.depth, depth);
+
+    AABB bounds;
+    AABB centroidBounds;
+    for (u32 i = begin; i < end; ++i)
+    {
+        bounds.grow(primitiveBounds[this->_indices[i]]);
+        centroidBounds.grow(this->_centroids[this->_indices[i]]);
+    }
+
+    u32 count = end - begin;
+
+    // Sweep the primitives sorted along each axis and find the cheapest split.
+    f32 bestCost = FLT_MAX;
+    i32 bestAxis = -1;
+    u32 bestSplit = 0;
+    i32 sortedAxis = -1;
+
+    if (count > 1)
+    {
+        vec3 centroidExtent = centroidBounds.extent();
+        for (i32 axis = 0; axis < 3; ++axis)
+        {
+            if (centroidExtent[axis] <= 0.0f)
+            {
+                continue;
+            }
+
+            std::sort(this->_indices.begin() + begin, this->_indices.begin() + end,
+                [this, axis](u32 a, u32 b) { return this->_centroids[a][axis] < this->_centroids[b][axis]; });
+            sortedAxis = axis;
+
+            AABB right;
+            for (u32 i = end - 1; i > begin; --i)
+            {
+                right.grow(primitiveBounds[this->_indices[i]]);
+                this->_rightAreas[i] = right.area();
+            }
+
+            AABB left;
+            for (u32 i = begin + 1; i < end; ++i)
+            {
+                left.grow(primitiveBounds[this->_indices[i - 1]]);
+                f32 cost = left.area() * (f32)(i - begin) + this->_rightAreas[i] * (f32)(end - i);
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+    }
+
+    f32 area = bounds.area();
+    f32 leafCost = INTERSECTION_COST * (f32)count;
+    f32 splitCost = area > 0.0f ? TRAVERSAL_COST + INTERSECTION_COST * bestCost / area : FLT_MAX;
+
+    bool makeLeaf = count == 1 ||
+        (count <= this->_maxLeafSize && leafCost <= splitCost) ||
+        depth >= MAX_DEPTH;
+
+    if (bestAxis < 0 && !makeLeaf)
+    {
+        // All centroids coincide. Split in the middle as the SAH can't help.
+        bestAxis = sortedAxis = 0;
+        bestSplit = begin + count / 2;
+    }
+
+    if (makeLeaf)
+    {
+        assert(count <= 0xffff);
+
+        BVHNode &node = nodes.data[nodeIndex];
+        node.bounds = bounds;
+        node.offset = begin;
+        node.count = (u16)count;
+        node.axis = 0;
+        return nodeIndex;
+    }
+
+    // The sweep of the last axis left the primitives in its order.
+    if (bestAxis != sortedAxis)
+    {
+        std::sort(this->_indices.begin() + begin, this->_indices.begin() + end,
+            [this, bestAxis](u32 a, u32 b) { return this->_centroids[a][bestAxis] < this->_centroids[b][bestAxis]; });
+    }
+
+    this->_build(nodes, begin, bestSplit, depth + 1);
+    u32 secondChild = this->_build(nodes, bestSplit, end, depth + 1);
+
+    BVHNode &node = nodes.data[nodeIndex];
+    node.bounds = bounds;
+    node.offset = secondChild;
+    node.count = 0;
+    node.axis = (u16)bestAxis;
+
+    return nodeIndex;
+}
+
+u32 BVH::_buildBinned(_Nodes &nodes, _Bins &bins, u32 begin, u32 end, const AABB &bounds, const AABB &centroidBounds, u32 depth) noexcept
+{
+    u32 count = end - begin;
+    if (count <= cy::Max(SWEEP_SIZE, this->_maxLeafSize))
+    {
+        return this->_build(nodes, begin, end, depth);
+    }
+
+    u32 nodeIndex = nodes.size++;
+    nodes.depth = cy::Max(nodes.depth, depth);
+
+    BVHNode &node = nodes.data[nodeIndex];
+    node.bounds = bounds;
+
+    if (depth >= MAX_DEPTH)
+    {
+        assert(count <= 0xffff);
+
+        node.offset = begin;
+        node.count = (u16)count;
+        node.axis = 0;
+        return nodeIndex;
+    }
+
+    _Binning binning(centroidBounds);
+    bins.clear();
+    bins.add(this->_indices.data(), this->_centroids.data(), this->_primitiveBounds->data(), begin, end, binning);
+    _Split split = bins.split(binning);
+
+    u32 middle = _Partition(this->_indices.data(), this->_centroids.data(), this->_primitiveBounds->data(), begin, end, binning, split);
+
+    this->_buildBinned(nodes, bins, begin, middle, split.leftBounds, split.leftCentroidBounds, depth + 1);
+    u32 secondChild = this->_buildBinned(nodes, bins, middle, end, split.rightBounds, split.rightCentroidBounds, depth + 1);
+
+    // The buffer never grows, so the node is still there.
+    node.offset = secondChild;
+    node.count = 0;
+    node.axis = (u16)split.axis;
+
+    return nodeIndex;
+}
+
+void BVH::_splitTop(std::vector<_TopNode> &top, std::vector<_Task> &tasks, u32 begin, u32 end,
+    const AABB &bounds, const AABB &centroidBounds, u32 depth, u32 taskSize, ThreadPool *pool, Arena *arenas) noexcept
+{
+    u32 count = end - begin;
+
+    u32 topIndex = (u32)top.size();
+    top.push_back(_TopNode{0, 0, -1});
+
+    // At the depth limit the task makes the leaf.
+    if (count <= taskSize || depth >= MAX_DEPTH)
+    {
+        top[topIndex].task = (i32)tasks.size();
+        tasks.push_back(_Task{begin, end, depth, bounds, centroidBounds, nullptr, 0, 0});
+        return;
+    }
+
+    // Each task bins a chunk of the primitives into bins of its own from
+    // the arena of its thread, and they are merged afterwards.
+    _Binning binning(centroidBounds);
+    u32 numChunks = _NumChunks(count, pool);
+    std::vector<_Bins *> chunkBins(numChunks);
+    _Run(pool, numChunks, [&](u32 chunk, u32 thread)
+    {
+        u32 chunkBegin = begin + (u32)((u64)count * chunk / numChunks);
+        u32 chunkEnd = begin + (u32)((u64)count * (chunk + 1) / numChunks);
+
+        _Bins *bins = arenas[thread].create<_Bins>();
+        bins->add(this->_indices.data(), this->_centroids.data(), this->_primitiveBounds->data(), chunkBegin, chunkEnd, binning);
+        chunkBins[chunk] = bins;
+    });
+
+    _Bins &bins = *chunkBins[0];
+    for (u32 chunk = 1; chunk < numChunks; ++chunk)
+    {
+        bins.merge(*chunkBins[chunk]);
+    }
+    _Split split = bins.split(binning);
+
+    u32 middle = _Partition(this->_indices.data(), this->_centroids.data(), this->_primitiveBounds->data(), begin, end, binning, split);
+
+    top[topIndex].axis = (u16)split.axis;
+
+    this->_splitTop(top, tasks, begin, middle, split.leftBounds, split.leftCentroidBounds, depth + 1, taskSize, pool, arenas);
+    top[topIndex].second = (u32)top.size();
+    this->_splitTop(top, tasks, middle, end, split.rightBounds, split.rightCentroidBounds, depth + 1, taskSize, pool, arenas);
+}
+
+u32 BVH::_emit(const std::vector<_TopNode> &top, const std::vector<_Task> &tasks, u32 topIndex) noexcept
+{
+    const _TopNode &topNode = top[topIndex];
+    u32 nodeIndex = (u32)this->_nodes.size();
+
+    if (topNode.task >= 0)
+    {
+        const _Task &task = tasks[topNode.task];
+        for (u32 i = 0; i < task.numNodes; ++i)
+        {
+            BVHNode node = task.nodes[i];
+            if (!node.leaf())
+            {
+                node.offset += nodeIndex;
+            }
+            this->_nodes.push_back(node);
+        }
+        return nodeIndex;
+    }
+
+    this->_nodes.push_back(BVHNode());
+    this->_emit(top, tasks, topIndex + 1);
+    u32 secondChild = this->_emit(top, tasks, topNode.second);
+
+    // The bounds are only known once the subtrees are built.
+    BVHNode &node = this->_nodes[nodeIndex];
+    node.bounds = this->_nodes[nodeIndex + 1].bounds;
+    node.bounds.grow(this->_nodes[secondChild].bounds);
+    node.offset = secondChild;
+    node.count = 0;
+    node.axis = topNode.axis;
+
+    return nodeIndex;
+}
+
+template <typename Code>
+void BVH::_buildLinear(ThreadPool *pool, bool optimizeTreelets) noexcept
+{
+    const std::vector<AABB> &primitiveBounds = *this->_primitiveBounds;
+    u32 numPrimitives = (u32)primitiveBounds.size();
+
+    u32 numThreads = pool != nullptr ? pool->size() : 1;
+    std::unique_ptr<Arena[]> arenas(new Arena[numThreads]);
+
+    u32 numChunks = _NumChunks(numPrimitives, pool);
+    std::vector<AABB> chunkCentroidBounds(numChunks);
+    _Run(pool, numChunks, [&](u32 chunk, u32)
+    {
+        u32 begin = (u32)((u64)numPrimitives * chunk / numChunks);
+        u32 end = (u32)((u64)numPrimitives * (chunk + 1) / numChunks);
+        for (u32 i = begin; i < end; ++i)
+        {
+            this->_centroids[i] = primitiveBounds[i].centroid();
+            chunkCentroidBounds[chunk].grow(this->_centroids[i]);
+        }
+    });
+
+    AABB centroidBounds;
+    for (u32 chunk = 0; chunk < numChunks; ++chunk)
+    {
+        centroidBounds.grow(chunkCentroidBounds[chunk]);
+    }
+
+    // Quantize the centroids on the grid over their bounds.
+    const u32 BITS = _Morton<Code>::BITS;
+    const f32 GRID = (f32)(1u << BITS);
+    vec3 origin = centroidBounds.min;
+    vec3 extent = centroidBounds.extent();
+    vec3 scale;
+    for (i32 axis = 0; axis < 3; ++axis)
+    {
+        f32 s = extent[axis] > 0.0f ? GRID / extent[axis] : 0.0f;
+        scale[axis] = s < FLT_MAX ? s : 0.0f;
+    }
+
+    std::vector<Code> codes(numPrimitives);
+    _Run(pool, numChunks, [&](u32 chunk, u32)
+    {
+        u32 begin = (u32)((u64)numPrimitives * chunk / numChunks);
+        u32 end = (u32)((u64)numPrimitives * (chunk + 1) / numChunks);
+        for (u32 i = begin; i < end; ++i)
+        {
+            Code code = 0;
+            for (i32 axis = 0; axis < 3; ++axis)
+            {
+                u32 q = (u32)cy::Min((this->_centroids[i][axis] - origin[axis]) * scale[axis], GRID - 1.0f);
+                code |= _Morton<Code>::expand(q) << (2 - axis);
+            }
+            codes[i] = code;
+            this->_indices[i] = i;
+        }
+    });
+
+    _RadixSort(codes, this->_indices, 3 * BITS, pool);
+
+    // Enough subtrees for the work stealing to even them out.
+    u32 taskSize = cy::Max(numPrimitives / (numThreads * TASKS_PER_THREAD), MIN_TASK_SIZE);
+
+    std::vector<_TopNode> top;
+    std::vector<_Task> tasks;
+    this->_splitLinearTop(top, tasks, codes.data(), 0, numPrimitives, 1, 3 * BITS - 1, taskSize);
+
+    _Run(pool, (u32)tasks.size(), [&](u32 index, u32 thread)
+    {
+        _Task &task = tasks[index];
+        u32 count = task.end - task.begin;
+
+        BVHNode *data = (BVHNode *)arenas[thread].allocate((2 * count - 1) * sizeof(BVHNode), alignof(BVHNode));
+        _Nodes nodes = {data, 0, 0};
+        f32 cost;
+        this->_buildLinear(nodes, codes.data(), task.begin, task.end, task.depth, 3 * BITS - 1, cost);
+
+        task.nodes = data;
+        task.numNodes = nodes.size;
+        task.maxDepth = nodes.depth;
+
+        if (optimizeTreelets)
+        {
+            this->_optimizeTreelets(task, arenas[thread]);
+        }
+    });
+
+    this->_nodes.reserve(2 * numPrimitives - 1);
+    this->_emit(top, tasks, 0);
+
+    for (const _Task &task : tasks)
+    {
+        this->_depth = cy::Max(this->_depth, task.maxDepth);
+    }
+}
+
+template <typename Code>
+u32 BVH::_buildLinear(_Nodes &nodes, const Code *codes, u32 begin, u32 end, u32 depth, u32 bit, f32 &out_cost) noexcept
+{
+    const std::vector<AABB> &primitiveBounds = *this->_primitiveBounds;
+
+    u32 nodeIndex = nodes.size++;
+    u32 maxDepth = nodes.depth;
+    nodes.depth = cy::Max(nodes.depth, depth);
+
+    u32 count = end - begin;
+    if (count == 1)
+    {
+        BVHNode &node = nodes.data[nodeIndex];
+        node.bounds = primitiveBounds[this->_indices[begin]];
+        node.offset = begin;
+        node.count = 1;
+        node.axis = 0;
+        out_cost = INTERSECTION_COST * node.bounds.area();
+        return nodeIndex;
+    }
+
+    // Split all the way down to single primitives, and collapse the small
+    // subtrees back into leaves below where the SAH says they are cheaper.
+    u16 axis;
+    u32 middle = _MortonSplit(codes, begin, end, depth, bit, axis);
+
+    f32 leftCost;
+    f32 rightCost;
+    this->_buildLinear(nodes, codes, begin, middle, depth + 1, bit, leftCost);
+    u32 secondChild = this->_buildLinear(nodes, codes, middle, end, depth + 1, bit, rightCost);
+
+    BVHNode &node = nodes.data[nodeIndex];
+    node.bounds = nodes.data[nodeIndex + 1].bounds;
+    node.bounds.grow(nodes.data[secondChild].bounds);
+
+    f32 area = node.bounds.area();
+    f32 leafCost = INTERSECTION_COST * area * (f32)count;
+    f32 splitCost = TRAVERSAL_COST * area + leftCost + rightCost;
+    if (count <= this->_maxLeafSize && leafCost <= splitCost)
+    {
+        nodes.size = nodeIndex + 1;
+        nodes.depth = cy::Max(maxDepth, depth);
+
+        node.offset = begin;
+        node.count = (u16)count;
+        node.axis = 0;
+        out_cost = leafCost;
+        return nodeIndex;
+    }
+
+    node.offset = secondChild;
+    node.count = 0;
+    node.axis = axis;
+    out_cost = splitCost;
+
+    return nodeIndex;
+}
+
+template <typename Code>
+void BVH::_splitLinearTop(std::vector<_TopNode> &top, std::vector<_Task> &tasks, const Code *codes,
+    u32 begin, u32 end, u32 depth, u32 bit, u32 taskSize) noexcept
+{
+    u32 topIndex = (u32)top.size();
+    top.push_back(_TopNode{0, 0, -1});
+
+    if (end - begin <= taskSize)
+    {
+        top[topIndex].task = (i32)tasks.size();
+        tasks.push_back(_Task{begin, end, depth, AABB(), AABB(), nullptr, 0, 0});
+        return;
+    }
+
+    u16 axis;
+    u32 middle = _MortonSplit(codes, begin, end, depth, bit, axis);
+    top[topIndex].axis = axis;
+
+    this->_splitLinearTop(top, tasks, codes, begin, middle, depth + 1, bit, taskSize);
+    top[topIndex].second = (u32)top.size();
+    this->_splitLinearTop(top, tasks, codes, middle, end, depth + 1, bit, taskSize);
+}
+
+void BVH::_optimizeTreelets(_Task &task, Arena &arena) noexcept
+{
+    u32 numNodes = task.numNodes;
+
+    // Link the children explicitly, as the reordering breaks the depth-first
+    // order.
+    BVHNode *nodes = (BVHNode *)arena.allocate(numNodes * sizeof(BVHNode), alignof(BVHNode));
+    u32 *left = (u32 *)arena.allocate(numNodes * sizeof(u32), alignof(u32));
+    u32 *right = (u32 *)arena.allocate(numNodes * sizeof(u32), alignof(u32));
+    f32 *costs = (f32 *)arena.allocate(numNodes * sizeof(f32), alignof(f32));
+    memcpy(nodes, task.nodes, numNodes * sizeof(BVHNode));
+
+    // The children come after their parents, so going backwards reorders
+    // every treelet after the ones below it.
+    for (u32 i = numNodes; i-- > 0;)
+    {
+        const BVHNode &node = nodes[i];
+        if (node.leaf())
+        {
+            costs[i] = INTERSECTION_COST * node.bounds.area() * (f32)node.count;
+            continue;
+        }
+
+        left[i] = i + 1;
+        right[i] = node.offset;
+        costs[i] = TRAVERSAL_COST * node.bounds.area() + costs[left[i]] + costs[right[i]];
+
+        _ReorderTreelet(i, nodes, left, right, costs);
+    }
+
+    // Flatten it in depth-first order again.
+    const u32 NO_PARENT = ~0u;
+    struct Entry
+    {
+        u32 node;
+        u32 parent; /**< The flattened parent of a second child. */
+        u32 depth;
+    };
+    Entry *stack = (Entry *)arena.allocate(numNodes * sizeof(Entry), alignof(Entry));
+    BVHNode *flattened = (BVHNode *)arena.allocate(numNodes * sizeof(BVHNode), alignof(BVHNode));
+    u32 top = 0;
+    u32 numFlattened = 0;
+    u32 maxDepth = 0;
+
+    stack[top++] = Entry{0, NO_PARENT, task.depth};
+    while (top > 0)
+    {
+        Entry entry = stack[--top];
+
+        u32 index = numFlattened++;
+        flattened[index] = nodes[entry.node];
+        maxDepth = cy::Max(maxDepth, entry.depth);
+        if (entry.parent != NO_PARENT)
+        {
+            flattened[entry.parent].offset = index;
+        }
+
+        if (!nodes[entry.node].leaf())
+        {
+            stack[top++] = Entry{right[entry.node], index, entry.depth + 1};
+            stack[top++] = Entry{left[entry.node], NO_PARENT, entry.depth + 1};
+        }
+    }
+
+    // The reordered treelets may be deeper. Keep the subtree as it was if it
+    // got too deep for the traversal stack.
+    if (maxDepth > MAX_DEPTH)
+    {
+        return;
+    }
+
+    task.nodes = flattened;
+    task.maxDepth = maxDepth;
+}
+
+CS6620_NAMESPACE_END
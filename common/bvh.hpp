@@ -0,0 +1,395 @@
+/**
+ * \file bvh.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The bounding volume hierarchy over a set of primitive bounds. It only
+ * knows the primitives by their indices so that it can be shared by the
+ * scene level tree and the geometry level ones.
+ */
+
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include "common.h"
+
+#include <memory>
+#include <vector>
+
+#include "aabb.hpp"
+#include "ray.hpp"
+#include "stats.hpp"
+
+CS6620_NAMESPACE_BEGIN
+
+class Arena;
+class ThreadPool;
+
+/**
+ * A node of the flattened BVH. The nodes are stored in depth-first order so
+ * that the first child of an interior node is always next to it.
+ */
+struct BVHNode
+{
+    AABB bounds;  /**< The bounds of everything under this node. */
+    u32  offset;  /**< The first primitive if a leaf, otherwise the second child. */
+    u16  count;   /**< The number of primitives. 0 for interior nodes. */
+    u16  axis;    /**< The split axis of an interior node. */
+
+    bool leaf() const { return this->count > 0; }
+};
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode is stored as is in the snapshots and the BVH cache.");
+
+/**
+ * How a hierarchy is built.
+ */
+enum class BVHBuilder
+{
+    SAH,          /**< The binned SAH, see BVH::buildBinned(). */
+    LBVH,         /**< The linear BVH over Morton codes, see BVH::buildLinear(). */
+    LBVH_TREELET, /**< The linear BVH with its treelets reordered by the SAH. */
+};
+
+/**
+ * Parse the name of a BVH builder, i.e., "sah", "lbvh" or "lbvh-treelet".
+ * @return true if the name is known.
+ */
+extern bool ParseBVHBuilder(const char *name, BVHBuilder &out_builder);
+
+class BVH
+{
+public:
+    static const u32 MAX_DEPTH = 64; /**< Also the size of the traversal stack. */
+
+public:
+    /**
+     * Constructor.
+     */
+    explicit BVH();
+    /**
+     * Destructor.
+     */
+    ~BVH();
+    /**
+     * Build the hierarchy using the surface area heuristic.
+     * @param primitiveBounds the bounds of the primitives.
+     * @param maxLeafSize the leaf size below which a leaf is considered.
+     */
+    void build(const std::vector<AABB> &primitiveBounds, u32 maxLeafSize = 4) noexcept;
+    /**
+     * Build the hierarchy with the SAH evaluated on bins of the primitive
+     * centroids rather than a full sweep, which is far faster on large
+     * inputs for a slightly worse tree. The top-level splits bin the
+     * primitives in parallel and the subtrees below them are built as
+     * independent tasks, which finish with the full sweep once they get
+     * small.
+     * @param primitiveBounds the bounds of the primitives.
+     * @param maxLeafSize the leaf size below which a leaf is considered.
+     * @param pool the threads to build with. nullptr builds on the calling
+     * thread.
+     */
+    void buildBinned(const std::vector<AABB> &primitiveBounds, u32 maxLeafSize = 4, ThreadPool *pool = nullptr) noexcept;
+    /**
+     * Build a linear BVH, i.e., sort the primitives along the Morton curve
+     * through their centroids and split them at the highest differing bit
+     * of their codes. It's an order of magnitude faster than the SAH builds
+     * for a worse tree, which is meant for the scenes rebuilt all the time.
+     * @param primitiveBounds the bounds of the primitives.
+     * @param maxLeafSize the largest leaf.
+     * @param pool the threads to build with. nullptr builds on the calling
+     * thread.
+     * @param optimizeTreelets if the treelets of up to 7 leaves are
+     * reordered into their lowest SAH cost topology afterwards, which gets
+     * most of the SAH quality back for a few times the build time.
+     */
+    void buildLinear(const std::vector<AABB> &primitiveBounds, u32 maxLeafSize = 4, ThreadPool *pool = nullptr,
+        bool optimizeTreelets = false) noexcept;
+    /**
+     * Use a hierarchy built before, e.g., in a memory mapped file, without
+     * copying it.
+     * @param nodes the flattened nodes.
+     * @param numNodes the number of nodes.
+     * @param indices the primitive indices ordered by leaves.
+     * @param numIndices the number of primitives.
+     * @param depth the depth of the hierarchy.
+     * @param owner keeps the memory of the nodes and indices alive.
+     */
+    void map(const BVHNode *nodes, u32 numNodes, const u32 *indices, u32 numIndices, u32 depth, std::shared_ptr<const void> owner) noexcept;
+    /**
+     * Fit the node bounds to the moved primitives bottom up, keeping the
+     * topology and the primitive order, which is far cheaper than a build
+     * but gets worse the farther the primitives move from where the
+     * hierarchy was built for. A mapped hierarchy is copied first.
+     * @param primitiveBounds the new bounds of the same primitives.
+     */
+    void refit(const std::vector<AABB> &primitiveBounds) noexcept;
+    /**
+     * The SAH cost of the hierarchy relative to its root area, i.e., the
+     * expected cost of a ray through the root, which tells how well it
+     * fits the primitives.
+     */
+    f32 sahCost() const noexcept;
+    /**
+     * Check that the node links and the primitive ranges of a saved
+     * hierarchy stay inside it and it's not deeper than the traversal stack,
+     * so a broken file can't send the traversal astray.
+     * @return true if the hierarchy is safe to map.
+     */
+    static bool validate(const BVHNode *nodes, u32 numNodes, u32 numIndices) noexcept;
+    /**
+     * Walk the hierarchy and visit the leaves along the ray in roughly
+     * front-to-back order.
+     * @param ray the ray.
+     * @param tmax the current nearest hit distance. The callback shrinks it.
+     * @param intersectLeaf called as bool(u32 first, u32 count, f32 &tmax)
+     * with the leaf's range in indices() and returns true if any primitive
+     * is hit closer than tmax.
+     * @return true if any primitive is hit.
+     */
+    template <typename F>
+    bool intersect(const Ray &ray, f32 &tmax, F &&intersectLeaf) const noexcept;
+    /**
+     * Walk the hierarchy until any leaf along the ray reports a hit, e.g.,
+     * for a shadow ray.
+     * @param ray the ray.
+     * @param tmax the farthest distance along the ray that counts.
+     * @param occludedLeaf called as bool(u32 first, u32 count, f32 &tmax)
+     * with the leaf's range in indices() and returns true if any primitive
+     * is hit closer than tmax.
+     * @return true if any primitive is hit.
+     */
+    template <typename F>
+    bool occluded(const Ray &ray, f32 tmax, F &&occludedLeaf) const noexcept;
+
+    const BVHNode *nodes() const { return this->_mappedNodes != nullptr ? this->_mappedNodes : this->_nodes.data(); }
+
+    u32 numNodes() const { return this->_mappedNodes != nullptr ? this->_numMappedNodes : (u32)this->_nodes.size(); }
+    /**
+     * The primitive indices referred by the leaves.
+     */
+    const u32 *indices() const { return this->_mappedNodes != nullptr ? this->_mappedIndices : this->_indices.data(); }
+
+    u32 numIndices() const { return this->_mappedNodes != nullptr ? this->_numMappedIndices : (u32)this->_indices.size(); }
+    /**
+     * The depth of the hierarchy. A single leaf has depth 1.
+     */
+    u32 depth() const { return this->_depth; }
+
+    AABB bounds() const { return this->numNodes() == 0 ? AABB() : this->nodes()[0].bounds; }
+
+private:
+    /**
+     * The nodes of a subtree under construction, in a buffer big enough for
+     * all of them. The node indices are relative to the buffer.
+     */
+    struct _Nodes
+    {
+        BVHNode *data;
+        u32      size;
+        u32      depth; /**< The depth of the deepest node so far. */
+    };
+    struct _Bins;
+    struct _TopNode;
+    struct _Task;
+
+    /**
+     * Start a build with the primitives in their original order.
+     */
+    void _begin(const std::vector<AABB> &primitiveBounds, u32 maxLeafSize) noexcept;
+    /**
+     * Release the build time data.
+     */
+    void _end() noexcept;
+    /**
+     * Recursively build the subtree of primitives [begin, end) with the
+     * full SAH sweep.
+     * @return the index of the created node.
+     */
+    u32 _build(_Nodes &nodes, u32 begin, u32 end, u32 depth) noexcept;
+    /**
+     * Recursively build the subtree of primitives [begin, end) with the
+     * binned SAH down to the size where the sweep takes over.
+     * @param bins the scratch bins, reused at every level.
+     * @return the index of the created node.
+     */
+    u32 _buildBinned(_Nodes &nodes, _Bins &bins, u32 begin, u32 end, const AABB &bounds, const AABB &centroidBounds, u32 depth) noexcept;
+    /**
+     * Recursively split the primitives [begin, end) with the binning done
+     * on the pool until they fall below the task size, and leave the
+     * subtrees from there to the tasks.
+     * @param arenas the scratch memory of each pool thread.
+     */
+    void _splitTop(std::vector<_TopNode> &top, std::vector<_Task> &tasks, u32 begin, u32 end,
+        const AABB &bounds, const AABB &centroidBounds, u32 depth, u32 taskSize, ThreadPool *pool, Arena *arenas) noexcept;
+    /**
+     * Build the linear BVH over the Morton codes of the given width.
+     */
+    template <typename Code>
+    void _buildLinear(ThreadPool *pool, bool optimizeTreelets) noexcept;
+    /**
+     * Recursively build the linear subtree of primitives [begin, end).
+     * @param codes the sorted Morton codes of all primitives.
+     * @param bit the highest bit the codes may differ at.
+     * @param out_cost return the SAH cost of the subtree, not normalized by
+     * any area.
+     * @return the index of the created node.
+     */
+    template <typename Code>
+    u32 _buildLinear(_Nodes &nodes, const Code *codes, u32 begin, u32 end, u32 depth, u32 bit, f32 &out_cost) noexcept;
+    /**
+     * Recursively split the linear primitives [begin, end) until they fall
+     * below the task size, and leave the subtrees from there to the tasks.
+     */
+    template <typename Code>
+    void _splitLinearTop(std::vector<_TopNode> &top, std::vector<_Task> &tasks, const Code *codes,
+        u32 begin, u32 end, u32 depth, u32 bit, u32 taskSize) noexcept;
+    /**
+     * Reorder the treelets of a built subtree bottom up into their lowest
+     * SAH cost topologies.
+     * @param arena where the reordered subtree and the scratch go.
+     */
+    void _optimizeTreelets(_Task &task, Arena &arena) noexcept;
+    /**
+     * Flatten the top-level node and the subtrees under it into the nodes.
+     * @return the index of the first node of it.
+     */
+    u32 _emit(const std::vector<_TopNode> &top, const std::vector<_Task> &tasks, u32 topIndex) noexcept;
+
+private:
+    std::vector<BVHNode> _nodes;   /**< The flattened nodes. */
+    std::vector<u32>     _indices; /**< The primitive indices ordered by leaves. */
+    u32                  _depth = 0;
+
+    // The hierarchy owned by someone else. Used instead of the above if set.
+    const BVHNode              *_mappedNodes = nullptr;
+    const u32                  *_mappedIndices = nullptr;
+    u32                         _numMappedNodes = 0;
+    u32                         _numMappedIndices = 0;
+    std::shared_ptr<const void> _mapping;
+
+    // Build time only data.
+    const std::vector<AABB> *_primitiveBounds = nullptr;
+    std::vector<vec3>        _centroids;
+    std::vector<f32>         _rightAreas; /**< The scratch buffer for the SAH sweep. */
+    u32                      _maxLeafSize = 4;
+};
+
+template <typename F>
+bool BVH::intersect(const Ray &ray, f32 &tmax, F &&intersectLeaf) const noexcept
+{
+    const BVHNode *nodes = this->nodes();
+    if (this->numNodes() == 0)
+    {
+        return false;
+    }
+
+    vec3 invDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+    bool negative[3] = { invDirection.x < 0.0f, invDirection.y < 0.0f, invDirection.z < 0.0f };
+
+    u32 stack[MAX_DEPTH];
+    u32 top = 0;
+    u32 current = 0;
+    u32 visits = 0;
+    bool hit = false;
+
+    while (true)
+    {
+        const BVHNode &node = nodes[current];
+        ++visits;
+        if (node.bounds.intersect(ray.origin, invDirection, tmax))
+        {
+            if (node.leaf())
+            {
+                if (intersectLeaf(node.offset, (u32)node.count, tmax))
+                {
+                    hit = true;
+                }
+            }
+            else
+            {
+                // Visit the near child first and postpone the far one.
+                if (negative[node.axis])
+                {
+                    stack[top++] = current + 1;
+                    current = node.offset;
+                }
+                else
+                {
+                    stack[top++] = node.offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+        }
+
+        if (top == 0)
+        {
+            break;
+        }
+        current = stack[--top];
+    }
+
+    CS6620_STATS_ADD(NODE_VISITS, visits);
+
+    return hit;
+}
+
+template <typename F>
+bool BVH::occluded(const Ray &ray, f32 tmax, F &&occludedLeaf) const noexcept
+{
+    const BVHNode *nodes = this->nodes();
+    if (this->numNodes() == 0)
+    {
+        return false;
+    }
+
+    vec3 invDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+    u32 stack[MAX_DEPTH];
+    u32 top = 0;
+    u32 current = 0;
+    u32 visits = 0;
+    bool hit = false;
+
+    while (true)
+    {
+        const BVHNode &node = nodes[current];
+        ++visits;
+        if (node.bounds.intersect(ray.origin, invDirection, tmax))
+        {
+            if (node.leaf())
+            {
+                if (occludedLeaf(node.offset, (u32)node.count, tmax))
+                {
+                    hit = true;
+                    break;
+                }
+            }
+            else
+            {
+                // Any hit ends the walk, so the near child gains little.
+                // Take the adjacent first child without looking at the ray.
+                stack[top++] = node.offset;
+                current = current + 1;
+                continue;
+            }
+        }
+
+        if (top == 0)
+        {
+            break;
+        }
+        current = stack[--top];
+    }
+
+    CS6620_STATS_ADD(NODE_VISITS, visits);
+
+    return hit;
+}
+
+CS6620_NAMESPACE_END
+
+
+#endif // !BVH_HPP
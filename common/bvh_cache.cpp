@@ -0,0 +1,227 @@
+/**
+ * \file bvh_cache.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The on-disk cache of the built BVHs.
+ */
+
+#include "bvh_cache.hpp"
+
+#include "bvh.hpp"
+#include "mapped_file.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+CS6620_NAMESPACE_BEGIN
+
+static const u64 HASH_K1 = 0x9e3779b97f4a7c15ull;
+static const u64 HASH_K2 = 0xc2b2ae3d27d4eb4full;
+
+static u64 _Align(u64 offset)
+{
+    return (offset + BVH_CACHE_ALIGNMENT - 1) / BVH_CACHE_ALIGNMENT * BVH_CACHE_ALIGNMENT;
+}
+
+static u64 _Rotate(u64 x, u32 r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * The finalizer of MurmurHash3, which spreads every bit over the word.
+ */
+static u64 _Mix(u64 x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+u64 BVHCache::hash(const void *data, size_t size, u64 seed) noexcept
+{
+    const u8 *bytes = (const u8 *)data;
+
+    u64 h = seed ^ ((u64)size * HASH_K1);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        u64 word;
+        memcpy(&word, bytes + i, 8);
+        h = _Rotate(h ^ (word * HASH_K2), 31) * HASH_K1;
+    }
+    if (i < size)
+    {
+        u64 word = 0;
+        memcpy(&word, bytes + i, size - i);
+        h = _Rotate(h ^ (word * HASH_K2), 31) * HASH_K1;
+    }
+    return _Mix(h);
+}
+
+BVHCache::BVHCache(const char *directory)
+    : _directory(directory)
+{
+}
+
+bool BVHCache::load(u64 key, u32 numPrimitives, BVH &out_bvh) const noexcept
+{
+    std::string path = this->_path(key);
+
+    // A miss is expected, so don't let the mapping complain about it.
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+    fclose(fp);
+
+    std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+    if (!mapping->open(path.c_str()))
+    {
+        return false;
+    }
+
+    const u8 *data = mapping->data();
+    u64 size = mapping->size();
+
+    const BVHCacheHeader *header = (const BVHCacheHeader *)data;
+    if (size < sizeof(BVHCacheHeader)
+        || memcmp(header->magic, BVH_CACHE_MAGIC, sizeof(BVH_CACHE_MAGIC)) != 0
+        || header->version != BVH_CACHE_VERSION
+        || header->byteOrder != BVH_CACHE_BYTE_ORDER)
+    {
+        LOG(WARNING) << "Ignore the stale BVH cache '" << path << "'.";
+        return false;
+    }
+
+    auto inside = [size](u64 offset, u64 bytes) {
+        return offset % BVH_CACHE_ALIGNMENT == 0 && offset <= size && bytes <= size - offset;
+    };
+
+    if (header->key != key
+        || header->fileSize != size
+        || header->numIndices != numPrimitives
+        || header->numNodes == 0
+        || header->depth > BVH::MAX_DEPTH
+        || !inside(header->nodesOffset, (u64)header->numNodes * sizeof(BVHNode))
+        || !inside(header->indicesOffset, (u64)header->numIndices * sizeof(u32)))
+    {
+        LOG(WARNING) << "Ignore the mismatched BVH cache '" << path << "'.";
+        return false;
+    }
+
+    const BVHNode *nodes = (const BVHNode *)(data + header->nodesOffset);
+    const u32 *indices = (const u32 *)(data + header->indicesOffset);
+    if (!BVH::validate(nodes, header->numNodes, header->numIndices))
+    {
+        LOG(WARNING) << "Ignore the broken BVH cache '" << path << "'.";
+        return false;
+    }
+    for (u32 i = 0; i < header->numIndices; ++i)
+    {
+        if (indices[i] >= numPrimitives)
+        {
+            LOG(WARNING) << "Ignore the broken BVH cache '" << path << "'.";
+            return false;
+        }
+    }
+
+    out_bvh.map(nodes, header->numNodes, indices, header->numIndices, header->depth, mapping);
+
+    LOG(INFO) << "BVH mapped from the cache '" << path << "'.";
+
+    return true;
+}
+
+/**
+ * Move a file over another one, replacing it if it exists. rename() does
+ * that on POSIX, where a process that still maps the old file keeps
+ * reading it. On Windows it fails on an existing target, and replacing a
+ * file another process maps fails as well, which leaves the old file in
+ * place for the next launch to try again.
+ * @return true if it succeeds.
+ */
+static bool _Replace(const char *from, const char *to)
+{
+#if defined(_WIN32)
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+bool BVHCache::save(u64 key, const BVH &bvh) const noexcept
+{
+#if defined(_WIN32)
+    _mkdir(this->_directory.c_str());
+#else
+    mkdir(this->_directory.c_str(), 0755);
+#endif
+
+    BVHCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BVH_CACHE_MAGIC, sizeof(BVH_CACHE_MAGIC));
+    header.version = BVH_CACHE_VERSION;
+    header.byteOrder = BVH_CACHE_BYTE_ORDER;
+    header.key = key;
+    header.numNodes = bvh.numNodes();
+    header.numIndices = bvh.numIndices();
+    header.depth = bvh.depth();
+    header.nodesOffset = _Align(sizeof(BVHCacheHeader));
+    header.indicesOffset = _Align(header.nodesOffset + (u64)header.numNodes * sizeof(BVHNode));
+    header.fileSize = header.indicesOffset + (u64)header.numIndices * sizeof(u32);
+
+    std::vector<u8> buffer(header.fileSize, 0);
+    memcpy(buffer.data(), &header, sizeof(header));
+    memcpy(buffer.data() + header.nodesOffset, bvh.nodes(), header.numNodes * sizeof(BVHNode));
+    memcpy(buffer.data() + header.indicesOffset, bvh.indices(), header.numIndices * sizeof(u32));
+
+    // Write aside and move it in place, so another launch never maps a
+    // half written file.
+    std::string path = this->_path(key);
+    std::string temporary = path + ".tmp";
+
+    FILE *fp = fopen(temporary.c_str(), "wb");
+    if (fp == nullptr)
+    {
+        LOG(ERROR) << "Fail to write the BVH cache '" << temporary << "'.";
+        return false;
+    }
+    bool written = fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size();
+    written = fclose(fp) == 0 && written;
+
+    if (!written || !_Replace(temporary.c_str(), path.c_str()))
+    {
+        LOG(ERROR) << "Fail to write the BVH cache '" << path << "'.";
+        remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+std::string BVHCache::_path(u64 key) const noexcept
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bvh", (unsigned long long)key);
+    return this->_directory + "/" + name;
+}
+
+CS6620_NAMESPACE_END
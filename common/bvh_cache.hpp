@@ -0,0 +1,101 @@
+/**
+ * \file bvh_cache.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The on-disk cache of the built BVHs.
+ */
+
+#ifndef BVH_CACHE_HPP
+#define BVH_CACHE_HPP
+
+#include "common.h"
+
+#include <cstddef>
+#include <string>
+
+CS6620_NAMESPACE_BEGIN
+
+class BVH;
+
+/**
+ * A cache file holds one BVH: a BVHCacheHeader followed by the nodes and
+ * the primitive indices, each aligned to BVH_CACHE_ALIGNMENT. The nodes
+ * refer to each other and to the indices by position, so the file is mapped
+ * and used as is.
+ *
+ * Bump BVH_CACHE_VERSION whenever the builder changes its output, so the
+ * hierarchies built by the old one are rebuilt.
+ */
+static const char BVH_CACHE_MAGIC[8] = { 'C', 'S', '6', '6', '2', '0', 'B', 'V' };
+static const u32  BVH_CACHE_VERSION = 2;
+static const u32  BVH_CACHE_BYTE_ORDER = 0x01020304;
+static const u32  BVH_CACHE_ALIGNMENT = 64;
+
+struct BVHCacheHeader
+{
+    char magic[8];
+    u32  version;
+    u32  byteOrder;     /**< BVH_CACHE_BYTE_ORDER as written by the machine. */
+    u64  key;
+    u64  fileSize;
+    u32  numNodes;
+    u32  numIndices;
+    u32  depth;
+    u32  reserved;
+    u64  nodesOffset;
+    u64  indicesOffset;
+};
+
+/**
+ * Save the built BVHs to a directory and map them back on later launches.
+ * A BVH is keyed by the hash of everything its build depends on, so one
+ * built from different inputs is never picked up.
+ */
+class BVHCache
+{
+public:
+    /**
+     * Hash a block of memory.
+     * @param data the memory.
+     * @param size the size in bytes.
+     * @param seed chain the hashes of several blocks by passing the last one.
+     * @return the 64-bit hash.
+     */
+    static u64 hash(const void *data, size_t size, u64 seed = 0) noexcept;
+
+public:
+    /**
+     * Constructor.
+     * @param directory the directory of the cache files. Created on the
+     * first save if missing.
+     */
+    explicit BVHCache(const char *directory);
+    /**
+     * Map the BVH saved with the key.
+     * @param key the hash of the build inputs.
+     * @param numPrimitives the number of primitives the BVH must be over.
+     * @param out_bvh return the mapped BVH.
+     * @return true on a hit.
+     */
+    bool load(u64 key, u32 numPrimitives, BVH &out_bvh) const noexcept;
+    /**
+     * Save the BVH with the key. A failure only leaves it uncached.
+     * @return true if it succeeds.
+     */
+    bool save(u64 key, const BVH &bvh) const noexcept;
+
+    const std::string &directory() const { return this->_directory; }
+
+private:
+    std::string _path(u64 key) const noexcept;
+
+private:
+    std::string _directory;
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !BVH_CACHE_HPP
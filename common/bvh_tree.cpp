@@ -0,0 +1,220 @@
+/**
+ * \file bvh_tree.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The ray-node intersection acceleration structure using a BVH.
+ */
+
+#include "bvh_tree.hpp"
+
+#include "scene_node.hpp"
+
+#include <cfloat>
+
+CS6620_NAMESPACE_BEGIN
+
+BVHTree::BVHTree(Scene *scene, const BVH *bvh, const BVHCache *cache, u32 width, BVHBuilder builder, ThreadPool *pool)
+    : Tree(scene)
+{
+    if (width != 2 && width != 4 && width != 8)
+    {
+        LOG(ERROR) << "BVH width " << width << " isn't supported and 2 is used instead.";
+        width = 2;
+    }
+    this->_width = width;
+    this->_builder = builder;
+
+    if (bvh != nullptr && bvh->numIndices() == this->_nodes.size())
+    {
+        this->_bvh = *bvh;
+    }
+    else
+    {
+        this->_build(this->_bounds(), cache, pool);
+    }
+
+    this->_compile();
+}
+
+BVHTree::~BVHTree()
+{
+}
+
+u32 BVHTree::numTraversedNodes() const
+{
+    switch (this->_width)
+    {
+    case 4:
+        return this->_bvh4.numNodes();
+    case 8:
+        return this->_bvh8.numNodes();
+    default:
+        return this->_bvh.numNodes();
+    }
+}
+
+bool BVHTree::update(f32 rebuildThreshold, ThreadPool *pool) noexcept
+{
+    std::vector<AABB> bounds = this->_bounds();
+
+    this->_bvh.refit(bounds);
+
+    f32 cost = this->_bvh.sahCost();
+    if (cost > this->_builtCost * rebuildThreshold)
+    {
+        LOG(INFO) << "The refit BVH's SAH cost " << cost << " is over " << rebuildThreshold << " times the "
+            << this->_builtCost << " at the build. Rebuilding it.";
+
+        // The moved nodes wouldn't hit the cache anyway.
+        this->_build(bounds, nullptr, pool);
+        this->_compile();
+        return true;
+    }
+
+    // Collapse the refit binary hierarchy again, which takes about as long
+    // as refitting the wide one would.
+    if (this->_width == 4)
+    {
+        this->_bvh4.build(this->_bvh);
+    }
+    else if (this->_width == 8)
+    {
+        this->_bvh8.build(this->_bvh);
+    }
+
+    this->_compiled.update();
+
+    return false;
+}
+
+std::vector<AABB> BVHTree::_bounds() const noexcept
+{
+    std::vector<AABB> bounds;
+    bounds.reserve(this->_nodes.size());
+    for (auto &&node : this->_nodes)
+    {
+        bounds.push_back(node->bounds());
+    }
+    return bounds;
+}
+
+void BVHTree::_build(const std::vector<AABB> &bounds, const BVHCache *cache, ThreadPool *pool) noexcept
+{
+    // Let a leaf hold up to a full SIMD register of spheres.
+    u32 maxLeafSize = cy::Max(SphereSoA::WIDTH, 4u);
+
+    // The node bounds already reflect their geometry and transforms, and
+    // they are all the build looks at besides the builder.
+    u32 numNodes = (u32)bounds.size();
+    u64 key = BVHCache::hash(&maxLeafSize, sizeof(maxLeafSize));
+    key = BVHCache::hash(&numNodes, sizeof(numNodes), key);
+    key = BVHCache::hash(bounds.data(), bounds.size() * sizeof(AABB), key);
+    if (this->_builder != BVHBuilder::SAH)
+    {
+        key = BVHCache::hash(&this->_builder, sizeof(this->_builder), key);
+    }
+
+    if (cache == nullptr || !cache->load(key, numNodes, this->_bvh))
+    {
+        if (this->_builder == BVHBuilder::SAH)
+        {
+            this->_bvh.buildBinned(bounds, maxLeafSize, pool);
+        }
+        else
+        {
+            this->_bvh.buildLinear(bounds, maxLeafSize, pool, this->_builder == BVHBuilder::LBVH_TREELET);
+        }
+
+        if (cache != nullptr)
+        {
+            cache->save(key, this->_bvh);
+        }
+    }
+}
+
+void BVHTree::_compile() noexcept
+{
+    // The wide hierarchies keep the leaves of the binary one, so the
+    // compiled primitives are in their leaf order as well.
+    if (this->_width == 4)
+    {
+        this->_bvh4.build(this->_bvh);
+    }
+    else if (this->_width == 8)
+    {
+        this->_bvh8.build(this->_bvh);
+    }
+
+    std::vector<GeometricNode *> leafNodes;
+    leafNodes.reserve(this->_bvh.numIndices());
+    for (u32 i = 0; i < this->_bvh.numIndices(); ++i)
+    {
+        leafNodes.push_back(this->_nodes[this->_bvh.indices()[i]]);
+    }
+    this->_compiled.build(leafNodes);
+
+    this->_builtCost = this->_bvh.sahCost();
+}
+
+bool BVHTree::intersect(const Ray &ray, SceneNode *&out_node, vec3 &out_position, vec3 &out_normal) const noexcept
+{
+    f32 distance = FLT_MAX;
+
+    // Only the nearest primitive is kept during the traversal. Its position
+    // and normal are computed once at the end.
+    u32 primitive = 0;
+    u32 face = 0;
+
+    auto intersectLeaf = [&](u32 first, u32 count, f32 &tmax)
+    {
+        CS6620_STATS_ADD(PRIMITIVE_TESTS, count);
+
+        return this->_compiled.intersect(ray, first, count, tmax, primitive, face);
+    };
+
+    bool hit;
+    switch (this->_width)
+    {
+    case 4:
+        hit = this->_bvh4.intersect(ray, distance, intersectLeaf);
+        break;
+    case 8:
+        hit = this->_bvh8.intersect(ray, distance, intersectLeaf);
+        break;
+    default:
+        hit = this->_bvh.intersect(ray, distance, intersectLeaf);
+        break;
+    }
+
+    if (hit)
+    {
+        out_node = this->_compiled.node(primitive);
+        this->_compiled.hit(ray, primitive, face, distance, out_position, out_normal);
+    }
+
+    return hit;
+}
+
+bool BVHTree::occluded(const Ray &ray, f32 tmax) const noexcept
+{
+    auto occludedLeaf = [&](u32 first, u32 count, f32 &distance)
+    {
+        CS6620_STATS_ADD(PRIMITIVE_TESTS, count);
+
+        return this->_compiled.occluded(ray, first, count, distance);
+    };
+
+    switch (this->_width)
+    {
+    case 4:
+        return this->_bvh4.occluded(ray, tmax, occludedLeaf);
+    case 8:
+        return this->_bvh8.occluded(ray, tmax, occludedLeaf);
+    default:
+        return this->_bvh.occluded(ray, tmax, occludedLeaf);
+    }
+}
+
+CS6620_NAMESPACE_END
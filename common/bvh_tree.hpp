@@ -0,0 +1,113 @@
+/**
+ * \file bvh_tree.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The ray-node intersection acceleration structure using a BVH.
+ */
+
+#ifndef BVH_TREE_HPP
+#define BVH_TREE_HPP
+
+#include "common.h"
+
+#include "tree.hpp"
+#include "bvh.hpp"
+#include "wide_bvh.hpp"
+#include "bvh_cache.hpp"
+#include "compiled_scene.hpp"
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * The tree that organizes the geometric nodes of the scene in a bounding
+ * volume hierarchy built with the surface area heuristic. The nodes are
+ * compiled into a CompiledScene in the order of the leaves, so a leaf is a
+ * contiguous range of primitives and its spheres are tested with SIMD at
+ * once. The binary hierarchy may be collapsed into a 4 or 8-ary one for
+ * the traversal, which tests the children of a node with SIMD at once.
+ *
+ * When the nodes move, e.g., in an animation, the hierarchy is refit to
+ * them rather than built again until its SAH cost gets too much worse than
+ * that of the last build.
+ */
+class BVHTree : public Tree
+{
+public:
+    /**
+     * Constructor. Build the hierarchy over the scene's geometric nodes.
+     * @param scene the scene.
+     * @param bvh the hierarchy built before over the same nodes, e.g., from
+     * a snapshot. It's used instead of building one if given.
+     * @param cache the cache to look the hierarchy up in before building
+     * one, and to save the built one to. Optional.
+     * @param width the children per node to traverse with, 2, 4 or 8.
+     * @param builder how to build the hierarchy, e.g., the linear BVH for
+     * the scenes rebuilt all the time.
+     * @param pool the threads to build with. Optional.
+     */
+    explicit BVHTree(Scene *scene, const BVH *bvh = nullptr, const BVHCache *cache = nullptr, u32 width = 2,
+        BVHBuilder builder = BVHBuilder::SAH, ThreadPool *pool = nullptr);
+    /**
+     * Destructor.
+     */
+    virtual ~BVHTree();
+    /**
+     * Compute the nearest intersection of a ray with the scene.
+     */
+    virtual bool intersect(const Ray &ray, SceneNode *&out_node, vec3 &out_position, vec3 &out_normal) const noexcept override;
+    /**
+     * If anything is hit by the ray closer than tmax. The hierarchy is
+     * walked in its memory order rather than front to back as the first
+     * hit found ends it.
+     */
+    virtual bool occluded(const Ray &ray, f32 tmax) const noexcept override;
+    /**
+     * Refit the hierarchy to the moved nodes, or rebuild it with the same
+     * builder if the refit one's SAH cost is over rebuildThreshold times
+     * the one at the last build.
+     */
+    virtual bool update(f32 rebuildThreshold, ThreadPool *pool) noexcept override;
+
+    const BVH &bvh() const { return this->_bvh; }
+    /**
+     * The children per node of the traversed hierarchy.
+     */
+    u32 width() const { return this->_width; }
+    /**
+     * The nodes of the traversed hierarchy.
+     */
+    u32 numTraversedNodes() const;
+
+    const CompiledScene &compiled() const { return this->_compiled; }
+
+private:
+    /**
+     * The current bounds of the nodes.
+     */
+    std::vector<AABB> _bounds() const noexcept;
+    /**
+     * Build the binary hierarchy, or load it from the cache.
+     */
+    void _build(const std::vector<AABB> &bounds, const BVHCache *cache, ThreadPool *pool) noexcept;
+    /**
+     * Set up the traversed hierarchy and the compiled primitives from the
+     * built binary one.
+     */
+    void _compile() noexcept;
+
+private:
+    BVH           _bvh;
+    WideBVH<4>    _bvh4;     /**< Collapsed from _bvh if the width is 4. */
+    WideBVH<8>    _bvh8;     /**< Collapsed from _bvh if the width is 8. */
+    u32           _width;
+    BVHBuilder    _builder;
+    f32           _builtCost = 0.0f; /**< The SAH cost at the last build. */
+    CompiledScene _compiled;         /**< The primitives in the order of the leaves. */
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !BVH_TREE_HPP
@@ -145,6 +145,24 @@ Ray Camera::unproject(f32 x, f32 y) const
     return ray;
 }
 
+void Camera::unproject(const f32xN &x, const f32xN &y, RayPacket<PACKET_WIDTH> &out_rays) const
+{
+    const f32xN half(0.5f);
+    const f32xN two(2.0f);
+    const f32xN one(1.0f);
+
+    out_rays.origin = vec3xN(this->position);
+
+    f32xN xx = (x + half) / f32xN((f32)this->width) * two - one;
+    f32xN yy = (f32xN((f32)(this->height - 1)) - y + half) / f32xN((f32)this->height) * two - one;
+
+    vec3xN sample = vec3xN(this->nearo) + vec3xN(this->nearx) * xx + vec3xN(this->nearz) * yy;
+
+    out_rays.direction = sample - out_rays.origin;
+    out_rays.direction.Normalize();
+    out_rays.active = maskxN(true);
+}
+
 
 
 CS6620_NAMESPACE_END
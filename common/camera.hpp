@@ -18,6 +18,7 @@
 #include "tinyxml2.h"
 
 #include "ray.hpp"
+#include "packet.hpp"
 
 CS6620_NAMESPACE_BEGIN
 
@@ -54,6 +55,11 @@ public:
      * Project a screen position in to a ray.
      */
     Ray unproject(f32 x, f32 y) const;
+    /**
+     * Project PACKET_WIDTH screen positions into a packet of rays, each the
+     * same as unproject() gives.
+     */
+    void unproject(const f32xN &x, const f32xN &y, RayPacket<PACKET_WIDTH> &out_rays) const;
 };
 
 
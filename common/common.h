@@ -12,16 +12,33 @@
 
 #include "cyMatrix.h"
 #include "cyVector.h"
+#include "simd_math.hpp"
 
 #include <glog/logging.h>
 
 typedef float f32;
+typedef double f64;
 typedef unsigned short u16;
 typedef unsigned int u32;
 typedef int i32;
 typedef short i16;
 typedef char i8;
 typedef unsigned char u8;
+typedef unsigned long long u64;
+typedef long long i64;
+
+// The SIMD instruction sets enabled by the compiler flags, e.g., /arch:AVX2
+// or -mavx2. x64 always has SSE2.
+#if defined(__AVX2__)
+#define CS6620_AVX2
+#endif
+// MSVC has no macro for F16C, but every CPU with AVX2 has it.
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define CS6620_F16C
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CS6620_SSE2
+#endif
 
 #define CS6620_NAMESPACE_BEGIN namespace cs6620 {
 #define CS6620_NAMESPACE_END };
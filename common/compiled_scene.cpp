@@ -0,0 +1,198 @@
+/**
+ * \file compiled_scene.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The render-only form of the scene geometry.
+ */
+
+#include "compiled_scene.hpp"
+
+#include "scene_node.hpp"
+#include "mesh.hpp"
+
+#include <map>
+
+CS6620_NAMESPACE_BEGIN
+
+CompiledScene::CompiledScene()
+{
+}
+
+CompiledScene::~CompiledScene()
+{
+}
+
+void CompiledScene::build(const std::vector<GeometricNode *> &nodes) noexcept
+{
+    this->_spheres.clear();
+    this->_meshInstances.clear();
+    this->_meshes.clear();
+    this->_worldToObject.clear();
+    this->_hasMeshes = false;
+    this->_materials.clear();
+    this->_nodes = nodes;
+    this->_materialNames.clear();
+
+    std::map<std::string, u32> materialIndices;
+
+    for (GeometricNode *node : nodes)
+    {
+        u32 meshInstance = NONE;
+
+        GeometricSphereNode *sphere = dynamic_cast<GeometricSphereNode *>(node);
+        GeometricMeshNode *mesh = dynamic_cast<GeometricMeshNode *>(node);
+        if (sphere != nullptr)
+        {
+            this->_spheres.add(sphere->center(), sphere->radius());
+        }
+        else
+        {
+            this->_spheres.addEmpty();
+
+            if (mesh != nullptr)
+            {
+                meshInstance = (u32)this->_meshes.size();
+                this->_meshes.push_back(mesh->mesh().get());
+                this->_worldToObject.push_back(mesh->inverseTransform());
+                this->_hasMeshes = true;
+            }
+            else
+            {
+                LOG(ERROR) << "The node '" << node->name << "' can't be compiled and is left out.";
+            }
+        }
+        this->_meshInstances.push_back(meshInstance);
+
+        u32 material = NONE;
+        if (node->material != nullptr)
+        {
+            auto it = materialIndices.find(node->material);
+            if (it == materialIndices.end())
+            {
+                it = materialIndices.insert(std::make_pair(std::string(node->material), (u32)this->_materialNames.size())).first;
+                this->_materialNames.push_back(node->material);
+            }
+            material = it->second;
+        }
+        this->_materials.push_back(material);
+    }
+}
+
+void CompiledScene::update() noexcept
+{
+    for (u32 i = 0; i < (u32)this->_nodes.size(); ++i)
+    {
+        GeometricNode *node = this->_nodes[i];
+
+        u32 instance = this->_meshInstances[i];
+        if (instance != NONE)
+        {
+            this->_worldToObject[instance] = static_cast<GeometricMeshNode *>(node)->inverseTransform();
+            continue;
+        }
+
+        GeometricSphereNode *sphere = dynamic_cast<GeometricSphereNode *>(node);
+        if (sphere != nullptr)
+        {
+            this->_spheres.set(i, sphere->center(), sphere->radius());
+        }
+    }
+}
+
+bool CompiledScene::intersect(const Ray &ray, u32 first, u32 count, f32 &tmax, u32 &out_primitive, u32 &out_face) const noexcept
+{
+    bool hit = false;
+
+    u32 slot;
+    if (this->_spheres.intersect(ray, first, count, tmax, slot))
+    {
+        out_primitive = slot;
+        hit = true;
+    }
+
+    if (this->_hasMeshes)
+    {
+        for (u32 i = first; i < first + count; ++i)
+        {
+            u32 instance = this->_meshInstances[i];
+            if (instance == NONE)
+            {
+                continue;
+            }
+
+            // The direction isn't normalized in object space, so the hit
+            // distance along it equals the one in world space.
+            const mat4 &worldToObject = this->_worldToObject[instance];
+            Ray objectRay;
+            objectRay.origin = vec3(worldToObject * ray.origin);
+            objectRay.direction = vec3(worldToObject.VectorTransform(ray.direction));
+
+            u32 face;
+            if (this->_meshes[instance]->intersect(objectRay, tmax, face))
+            {
+                out_primitive = i;
+                out_face = face;
+                hit = true;
+            }
+        }
+    }
+
+    return hit;
+}
+
+bool CompiledScene::occluded(const Ray &ray, u32 first, u32 count, f32 tmax) const noexcept
+{
+    // The spheres of a leaf take a vector or two, so finding the nearest of
+    // them costs no more than any of them.
+    f32 distance = tmax;
+    u32 slot;
+    if (this->_spheres.intersect(ray, first, count, distance, slot))
+    {
+        return true;
+    }
+
+    if (this->_hasMeshes)
+    {
+        for (u32 i = first; i < first + count; ++i)
+        {
+            u32 instance = this->_meshInstances[i];
+            if (instance == NONE)
+            {
+                continue;
+            }
+
+            const mat4 &worldToObject = this->_worldToObject[instance];
+            Ray objectRay;
+            objectRay.origin = vec3(worldToObject * ray.origin);
+            objectRay.direction = vec3(worldToObject.VectorTransform(ray.direction));
+
+            if (this->_meshes[instance]->occluded(objectRay, tmax))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void CompiledScene::hit(const Ray &ray, u32 primitive, u32 face, f32 distance, vec3 &out_position, vec3 &out_normal) const noexcept
+{
+    u32 instance = this->_meshInstances[primitive];
+    if (instance == NONE)
+    {
+        this->_spheres.hit(ray, primitive, distance, out_position, out_normal);
+        return;
+    }
+
+    out_position = ray.origin + ray.direction * distance;
+
+    // Normals transform by the inverse transpose.
+    const mat4 &worldToObject = this->_worldToObject[instance];
+    out_normal = vec3(worldToObject.TransposeMult(vec4(this->_meshes[instance]->normal(face), 0.0f)));
+    out_normal.Normalize();
+}
+
+CS6620_NAMESPACE_END
@@ -0,0 +1,124 @@
+/**
+ * \file compiled_scene.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The render-only form of the scene geometry.
+ */
+
+#ifndef COMPILED_SCENE_HPP
+#define COMPILED_SCENE_HPP
+
+#include "common.h"
+
+#include <string>
+#include <vector>
+
+#include "ray.hpp"
+#include "sphere_soa.hpp"
+
+CS6620_NAMESPACE_BEGIN
+
+class GeometricNode;
+class TriangleMesh;
+
+/**
+ * The geometric nodes flattened into primitives in world space, which is
+ * all the ray traversal needs, without the virtual calls and pointer
+ * chasing through the nodes.
+ *
+ * The data is split by how often it's touched. The intersection tests only
+ * read the per-type arrays, i.e., the spheres in a SphereSoA and the mesh
+ * instances with their world-to-object transforms. The materials are read
+ * once per hit, and the source nodes with their names and hierarchy only
+ * when the caller asks for them.
+ *
+ * A primitive has a slot in every per-primitive array so that a BVH leaf's
+ * range indexes them directly.
+ */
+class CompiledScene
+{
+public:
+    static const u32 NONE = 0xffffffff;
+
+public:
+    /**
+     * Constructor.
+     */
+    explicit CompiledScene();
+    /**
+     * Destructor.
+     */
+    ~CompiledScene();
+    /**
+     * Compile the nodes, whose order becomes the order of the primitives.
+     * The nodes must be prepared already.
+     */
+    void build(const std::vector<GeometricNode *> &nodes) noexcept;
+    /**
+     * Refresh the world space data of the primitives, i.e., the sphere
+     * centers and radii and the mesh transforms, after their nodes moved.
+     * The nodes and their order stay the same.
+     */
+    void update() noexcept;
+    /**
+     * Find the nearest primitive in [first, first + count) hit by the ray
+     * closer than tmax. The position and normal are computed once for the
+     * final hit by hit().
+     * @param ray the ray in world space.
+     * @param first the first primitive.
+     * @param count the number of primitives.
+     * @param tmax the nearest hit distance so far. Updated on a closer hit.
+     * @param out_primitive return the hit primitive.
+     * @param out_face return the hit face of a mesh.
+     * @return true if there's a hit closer than tmax.
+     */
+    bool intersect(const Ray &ray, u32 first, u32 count, f32 &tmax, u32 &out_primitive, u32 &out_face) const noexcept;
+    /**
+     * If any primitive in [first, first + count) is hit by the ray closer
+     * than tmax, stopping at the first one found.
+     */
+    bool occluded(const Ray &ray, u32 first, u32 count, f32 tmax) const noexcept;
+    /**
+     * Compute the hit position and normal in world space.
+     * @param ray the ray.
+     * @param primitive the hit primitive.
+     * @param face the hit face if it's a mesh.
+     * @param distance the hit distance along the ray.
+     */
+    void hit(const Ray &ray, u32 primitive, u32 face, f32 distance, vec3 &out_position, vec3 &out_normal) const noexcept;
+
+    u32 size() const { return (u32)this->_materials.size(); }
+    /**
+     * The material of a primitive, as an index into the material names, or
+     * NONE if it has none.
+     */
+    u32 material(u32 primitive) const { return this->_materials[primitive]; }
+
+    const std::string &materialName(u32 material) const { return this->_materialNames[material]; }
+
+    u32 numMaterials() const { return (u32)this->_materialNames.size(); }
+
+    GeometricNode *node(u32 primitive) const { return this->_nodes[primitive]; }
+
+private:
+    // Read by the intersection tests.
+    SphereSoA                         _spheres;       /**< Empty slots for the other primitives. */
+    std::vector<u32>                  _meshInstances; /**< The mesh instance of a primitive, or NONE. */
+    std::vector<const TriangleMesh *> _meshes;        /**< Per mesh instance, in object space. */
+    std::vector<mat4>                 _worldToObject; /**< Per mesh instance. */
+    bool                              _hasMeshes = false;
+
+    // Read once per hit.
+    std::vector<u32> _materials;
+
+    // Only for the callers.
+    std::vector<GeometricNode *> _nodes;
+    std::vector<std::string>     _materialNames;
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !COMPILED_SCENE_HPP
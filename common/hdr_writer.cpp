@@ -0,0 +1,304 @@
+/**
+ * \file hdr_writer.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * Write the linear RGB float images to .pfm or half-float .exr files,
+ * keeping the full dynamic range for compositing.
+ */
+
+#include "hdr_writer.hpp"
+
+#include "thread_pool.hpp"
+#include "profiler.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(CS6620_SSE2)
+#include <immintrin.h>
+#endif
+
+CS6620_NAMESPACE_BEGIN
+
+static const u32 ROWS_PER_TASK = 16;
+
+/**
+ * If the file name ends with the extension, e.g., ".pfm", ignoring the case.
+ */
+static bool _HasExtension(const char *filename, const char *extension)
+{
+    size_t n = strlen(filename);
+    size_t m = strlen(extension);
+    if (n < m)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < m; ++i)
+    {
+        if (tolower(filename[n - m + i]) != extension[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Convert a float to a half float in the same way as F16C does.
+ */
+static inline u16 _F32ToF16(f32 value)
+{
+    u32 x;
+    memcpy(&x, &value, sizeof(x));
+
+    u32 sign = (x >> 16) & 0x8000;
+    u32 abs = x & 0x7fffffff;
+
+    if (abs >= 0x7f800000)
+    {
+        // Infinity, or NaN quieted with the top of its payload kept.
+        return (u16)(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 | ((abs >> 13) & 0x3ff) : 0));
+    }
+    if (abs >= 0x477ff000)
+    {
+        // Rounds to 65520 or beyond.
+        return (u16)(sign | 0x7c00);
+    }
+    if (abs >= 0x38800000)
+    {
+        // Rebias the exponent from 127 to 15 and round the mantissa to the
+        // nearest even. A carry into the exponent is still right.
+        return (u16)(sign | ((abs - 0x38000000 + 0xfff + ((abs >> 13) & 1)) >> 13));
+    }
+    if (abs < 0x33000000)
+    {
+        // Below half of the smallest denormal.
+        return (u16)sign;
+    }
+
+    // A denormal half counts the steps of 2^-24.
+    u32 exponent = abs >> 23;
+    u32 mantissa = (abs & 0x7fffff) | 0x800000;
+    u32 shift = 126 - exponent;
+    u32 h = mantissa >> shift;
+    u32 rest = mantissa & ((1u << shift) - 1);
+    u32 halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (h & 1) != 0))
+    {
+        ++h;
+    }
+    return (u16)(sign | h);
+}
+
+bool IsHDRFile(const char *filename)
+{
+    return _HasExtension(filename, ".pfm") || _HasExtension(filename, ".exr");
+}
+
+void CvtF32ToF16(const f32 *src, u16 *dst, size_t n)
+{
+    size_t i = 0;
+
+#if defined(CS6620_F16C)
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i *)(dst + i), h);
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        dst[i] = _F32ToF16(src[i]);
+    }
+}
+
+bool WritePFM(const char *filename, u32 width, u32 height, const f32 *image) noexcept
+{
+    CS6620_PROFILE_SCOPE("Image write");
+
+    FILE *fp = fopen(filename, "wb");
+    if (fp == nullptr)
+    {
+        LOG(ERROR) << "Fail to write to " << filename;
+        return false;
+    }
+
+    // The negative scale marks the floats as little endian. The rows go
+    // from the bottom up.
+    fprintf(fp, "PF\n%u %u\n-1.0\n", width, height);
+
+    size_t rowSize = (size_t)width * 3;
+    bool succeeded = true;
+    for (u32 y = height; y > 0 && succeeded; --y)
+    {
+        succeeded = fwrite(image + (y - 1) * rowSize, sizeof(f32), rowSize, fp) == rowSize;
+    }
+
+    if (fclose(fp) != 0 || !succeeded)
+    {
+        LOG(ERROR) << "Fail to write to " << filename;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * The header of a single part scanline OpenEXR file, laid out byte by byte.
+ */
+class _EXRHeader
+{
+public:
+    void u8s(const void *data, size_t size)
+    {
+        const u8 *p = (const u8 *)data;
+        this->bytes.insert(this->bytes.end(), p, p + size);
+    }
+    void str(const char *s) { this->u8s(s, strlen(s) + 1); }
+    void i32s(i32 value) { this->u8s(&value, sizeof(value)); }
+    void f32s(f32 value) { this->u8s(&value, sizeof(value)); }
+    void attribute(const char *name, const char *type, i32 size)
+    {
+        this->str(name);
+        this->str(type);
+        this->i32s(size);
+    }
+
+public:
+    std::vector<u8> bytes;
+};
+
+bool WriteEXR(const char *filename, u32 width, u32 height, const f32 *image, ThreadPool *pool) noexcept
+{
+    CS6620_PROFILE_SCOPE("Image write");
+
+    const i32 HALF = 1;
+    const char *CHANNELS[] = {"B", "G", "R"}; // In alphabetical order as the format wants.
+
+    _EXRHeader header;
+    header.i32s(20000630); // The magic number.
+    header.i32s(2);        // Version 2, single part scanlines.
+
+    header.attribute("channels", "chlist", 3 * 18 + 1);
+    for (const char *channel : CHANNELS)
+    {
+        header.str(channel);
+        header.i32s(HALF);
+        header.i32s(0); // pLinear and the reserved bytes.
+        header.i32s(1); // The x sampling.
+        header.i32s(1); // The y sampling.
+    }
+    header.str("");
+
+    const u8 NO_COMPRESSION = 0;
+    header.attribute("compression", "compression", 1);
+    header.u8s(&NO_COMPRESSION, 1);
+    header.attribute("dataWindow", "box2i", 16);
+    header.i32s(0);
+    header.i32s(0);
+    header.i32s((i32)width - 1);
+    header.i32s((i32)height - 1);
+    header.attribute("displayWindow", "box2i", 16);
+    header.i32s(0);
+    header.i32s(0);
+    header.i32s((i32)width - 1);
+    header.i32s((i32)height - 1);
+    const u8 INCREASING_Y = 0;
+    header.attribute("lineOrder", "lineOrder", 1);
+    header.u8s(&INCREASING_Y, 1);
+    header.attribute("pixelAspectRatio", "float", 4);
+    header.f32s(1.0f);
+    header.attribute("screenWindowCenter", "v2f", 8);
+    header.f32s(0.0f);
+    header.f32s(0.0f);
+    header.attribute("screenWindowWidth", "float", 4);
+    header.f32s(1.0f);
+    header.str("");
+
+    // Uncompressed, every scanline is a chunk of its own, i.e., its y, its
+    // size and then each channel of the row in turn. The offset table
+    // before them points at each chunk in the file.
+    size_t rowSize = (size_t)width * 3;
+    size_t chunkSize = 8 + rowSize * sizeof(u16);
+    u64 firstChunk = header.bytes.size() + (u64)height * sizeof(u64);
+
+    std::vector<u64> offsets(height);
+    for (u32 y = 0; y < height; ++y)
+    {
+        offsets[y] = firstChunk + y * chunkSize;
+    }
+
+    std::vector<u8> chunks(chunkSize * height);
+    u32 numTasks = (height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    auto job = [&](u32 task, u32)
+    {
+        std::vector<u16> row(rowSize);
+
+        u32 y0 = task * ROWS_PER_TASK;
+        u32 y1 = cy::Min(y0 + ROWS_PER_TASK, height);
+        for (u32 y = y0; y < y1; ++y)
+        {
+            CvtF32ToF16(image + y * rowSize, row.data(), rowSize);
+
+            u8 *chunk = &chunks[y * chunkSize];
+            i32 size = (i32)(rowSize * sizeof(u16));
+            memcpy(chunk, &y, 4);
+            memcpy(chunk + 4, &size, 4);
+
+            u16 *b = (u16 *)(chunk + 8);
+            u16 *g = b + width;
+            u16 *r = g + width;
+            for (u32 x = 0; x < width; ++x)
+            {
+                r[x] = row[x * 3 + 0];
+                g[x] = row[x * 3 + 1];
+                b[x] = row[x * 3 + 2];
+            }
+        }
+    };
+
+    if (pool != nullptr && numTasks > 1)
+    {
+        pool->run(numTasks, job);
+    }
+    else
+    {
+        for (u32 task = 0; task < numTasks; ++task)
+        {
+            job(task, 0);
+        }
+    }
+
+    FILE *fp = fopen(filename, "wb");
+    if (fp == nullptr)
+    {
+        LOG(ERROR) << "Fail to write to " << filename;
+        return false;
+    }
+
+    bool succeeded = fwrite(header.bytes.data(), 1, header.bytes.size(), fp) == header.bytes.size() &&
+        fwrite(offsets.data(), sizeof(u64), offsets.size(), fp) == offsets.size() &&
+        fwrite(chunks.data(), 1, chunks.size(), fp) == chunks.size();
+
+    if (fclose(fp) != 0 || !succeeded)
+    {
+        LOG(ERROR) << "Fail to write to " << filename;
+        return false;
+    }
+    return true;
+}
+
+bool WriteHDR(const char *filename, u32 width, u32 height, const f32 *image, ThreadPool *pool) noexcept
+{
+    if (_HasExtension(filename, ".exr"))
+    {
+        return WriteEXR(filename, width, height, image, pool);
+    }
+    return WritePFM(filename, width, height, image);
+}
+
+CS6620_NAMESPACE_END
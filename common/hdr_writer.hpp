@@ -0,0 +1,60 @@
+/**
+ * \file hdr_writer.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * Write the linear RGB float images to .pfm or half-float .exr files,
+ * keeping the full dynamic range for compositing.
+ */
+
+#ifndef HDR_WRITER_HPP
+#define HDR_WRITER_HPP
+
+#include "common.h"
+
+#include <cstddef>
+
+CS6620_NAMESPACE_BEGIN
+
+class ThreadPool;
+
+/**
+ * If the file name ends with .pfm or .exr, ignoring the case.
+ */
+extern bool IsHDRFile(const char *filename);
+
+/**
+ * Convert floats to IEEE half floats, rounding to the nearest even, with
+ * F16C where available. Out of range values turn into infinity.
+ * @param n the number of values.
+ */
+extern void CvtF32ToF16(const f32 *src, u16 *dst, size_t n);
+
+/**
+ * Write an RGB float image to a .pfm file. The rows are written straight
+ * from the image without any copy.
+ * @return true if it succeeds.
+ */
+extern bool WritePFM(const char *filename, u32 width, u32 height, const f32 *image) noexcept;
+
+/**
+ * Write an RGB float image to an uncompressed OpenEXR file with half-float
+ * channels, half the size of a .pfm file.
+ * @param pool the threads to convert the rows with. nullptr converts on
+ * the calling thread.
+ * @return true if it succeeds.
+ */
+extern bool WriteEXR(const char *filename, u32 width, u32 height, const f32 *image, ThreadPool *pool = nullptr) noexcept;
+
+/**
+ * Write an RGB float image in the format given by the file extension,
+ * i.e., .pfm or .exr.
+ * @return true if it succeeds.
+ */
+extern bool WriteHDR(const char *filename, u32 width, u32 height, const f32 *image, ThreadPool *pool = nullptr) noexcept;
+
+CS6620_NAMESPACE_END
+
+
+#endif // !HDR_WRITER_HPP
@@ -0,0 +1,287 @@
+/**
+ * \file image_writer.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * Write the 8-bit RGB images to .ppm or .png files, optionally on a
+ * background thread, or stream them to a .ppm file a band of rows at a time.
+ */
+
+#include "image_writer.hpp"
+
+#include "ppm.h"
+#include "lodepng.h"
+#include "profiler.hpp"
+
+#include <cassert>
+#include <cctype>
+#include <cstring>
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * If the file name ends with .png, ignoring the case.
+ */
+static bool _IsPNG(const char *filename)
+{
+    size_t n = strlen(filename);
+    if (n < 4 || filename[n - 4] != '.')
+    {
+        return false;
+    }
+    return tolower(filename[n - 3]) == 'p' && tolower(filename[n - 2]) == 'n' && tolower(filename[n - 1]) == 'g';
+}
+
+bool ParsePNGCompression(const char *name, PNGCompression &out_compression)
+{
+    if (strcmp(name, "stored") == 0)
+    {
+        out_compression = PNGCompression::STORED;
+    }
+    else if (strcmp(name, "fast") == 0)
+    {
+        out_compression = PNGCompression::FAST;
+    }
+    else if (strcmp(name, "best") == 0)
+    {
+        out_compression = PNGCompression::BEST;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool WritePNG(const char *filename, u32 width, u32 height, const u8 *image, PNGCompression compression) noexcept
+{
+    lodepng::State state;
+    state.info_raw.colortype = LCT_RGB;
+    state.info_raw.bitdepth = 8;
+
+    LodePNGEncoderSettings &encoder = state.encoder;
+    switch (compression)
+    {
+    case PNGCompression::STORED:
+        // Skip the scan for a smaller color type too.
+        encoder.auto_convert = 0;
+        state.info_png.color.colortype = LCT_RGB;
+        state.info_png.color.bitdepth = 8;
+        encoder.filter_strategy = LFS_ZERO;
+        encoder.zlibsettings.btype = 0;
+        break;
+    case PNGCompression::FAST:
+        encoder.auto_convert = 0;
+        state.info_png.color.colortype = LCT_RGB;
+        state.info_png.color.bitdepth = 8;
+        encoder.filter_strategy = LFS_FOUR;
+        encoder.zlibsettings.btype = 1;
+        encoder.zlibsettings.windowsize = 256;
+        encoder.zlibsettings.nicematch = 32;
+        encoder.zlibsettings.lazymatching = 0;
+        break;
+    case PNGCompression::BEST:
+        encoder.filter_strategy = LFS_MINSUM;
+        encoder.zlibsettings.btype = 2;
+        encoder.zlibsettings.windowsize = 32768;
+        encoder.zlibsettings.nicematch = 258;
+        encoder.zlibsettings.lazymatching = 1;
+        break;
+    }
+
+    std::vector<u8> png;
+    unsigned error = lodepng::encode(png, image, width, height, state);
+    if (error == 0)
+    {
+        error = lodepng::save_file(png, filename);
+    }
+    if (error != 0)
+    {
+        LOG(ERROR) << "Fail to write to " << filename << ": " << lodepng_error_text(error);
+        return false;
+    }
+
+    return true;
+}
+
+ImageWriter::ImageWriter()
+{
+}
+
+ImageWriter::~ImageWriter()
+{
+    if (this->_stream != nullptr)
+    {
+        this->endStream();
+    }
+    this->wait();
+
+    if (this->_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            this->_exit = true;
+        }
+        this->_changed.notify_all();
+        this->_thread.join();
+    }
+}
+
+bool ImageWriter::write(const char *filename, u32 width, u32 height, const u8 *image, PNGCompression compression) noexcept
+{
+    CS6620_PROFILE_SCOPE("Image write");
+
+    if (_IsPNG(filename))
+    {
+        return WritePNG(filename, width, height, image, compression);
+    }
+    return WritePPM(filename, (int)width, (int)height, image);
+}
+
+void ImageWriter::writeAsync(const char *filename, u32 width, u32 height, std::vector<u8> &&image, PNGCompression compression) noexcept
+{
+    Job job;
+    job.filename = filename;
+    job.width = width;
+    job.height = height;
+    job.image = std::move(image);
+    job.compression = compression;
+    this->_push(std::move(job));
+}
+
+bool ImageWriter::wait() noexcept
+{
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    this->_changed.wait(lock, [this]() { return this->_jobs.empty(); });
+
+    bool succeeded = !this->_failed;
+    this->_failed = false;
+    return succeeded;
+}
+
+bool ImageWriter::beginStream(const char *filename, u32 width, u32 height) noexcept
+{
+    assert(this->_stream == nullptr);
+
+    if (_IsPNG(filename))
+    {
+        LOG(ERROR) << "Fail to stream to " << filename << ": only .ppm files can be streamed.";
+        return false;
+    }
+
+    // The rows of a stream are appended by the background thread, so no
+    // other write may be on the way to the same file.
+    this->wait();
+
+    this->_stream = OpenPPM(filename, (int)width, (int)height);
+    if (this->_stream == nullptr)
+    {
+        return false;
+    }
+    this->_streamFilename = filename;
+    this->_streamWidth = width;
+    this->_streamHeight = height;
+    this->_streamRows = 0;
+    return true;
+}
+
+void ImageWriter::appendAsync(std::vector<u8> &&rows) noexcept
+{
+    assert(this->_stream != nullptr);
+    assert(rows.size() % ((size_t)this->_streamWidth * 3) == 0);
+
+    Job job;
+    job.filename = this->_streamFilename;
+    job.width = this->_streamWidth;
+    job.height = (u32)(rows.size() / ((size_t)this->_streamWidth * 3));
+    job.image = std::move(rows);
+    job.compression = PNGCompression::STORED;
+    job.append = true;
+    this->_push(std::move(job));
+}
+
+bool ImageWriter::endStream() noexcept
+{
+    assert(this->_stream != nullptr);
+
+    bool ret = this->wait();
+    if (ret && this->_streamRows != this->_streamHeight)
+    {
+        LOG(ERROR) << "Fail to write to " << this->_streamFilename << ": " << this->_streamRows
+            << " of " << this->_streamHeight << " rows are written.";
+        ret = false;
+    }
+
+    if (fclose(this->_stream) != 0 && ret)
+    {
+        LOG(ERROR) << "Fail to write to " << this->_streamFilename;
+        ret = false;
+    }
+    this->_stream = nullptr;
+    return ret;
+}
+
+void ImageWriter::_push(Job &&job) noexcept
+{
+    std::unique_lock<std::mutex> lock(this->_mutex);
+
+    if (!this->_thread.joinable())
+    {
+        this->_thread = std::thread(&ImageWriter::_work, this);
+    }
+
+    // Hold the caller back rather than pile up frames in memory when the
+    // writes can't keep up.
+    this->_changed.wait(lock, [this]() { return this->_jobs.size() < MAX_PENDING; });
+
+    this->_jobs.push_back(std::move(job));
+
+    lock.unlock();
+    this->_changed.notify_all();
+}
+
+bool ImageWriter::_append(const Job &job) noexcept
+{
+    CS6620_PROFILE_SCOPE("Image write");
+
+    if (this->_streamRows + job.height > this->_streamHeight)
+    {
+        LOG(ERROR) << "Fail to write to " << job.filename << ": more rows than the image has.";
+        return false;
+    }
+
+    if (fwrite(job.image.data(), 1, job.image.size(), this->_stream) != job.image.size())
+    {
+        LOG(ERROR) << "Fail to write to " << job.filename;
+        return false;
+    }
+    this->_streamRows += job.height;
+    return true;
+}
+
+void ImageWriter::_work() noexcept
+{
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    while (true)
+    {
+        this->_changed.wait(lock, [this]() { return this->_exit || !this->_jobs.empty(); });
+        if (this->_jobs.empty())
+        {
+            break;
+        }
+
+        // The job stays queued while it's written, so wait() also waits for it.
+        Job &job = this->_jobs.front();
+        lock.unlock();
+        bool succeeded = job.append ? this->_append(job)
+            : this->write(job.filename.c_str(), job.width, job.height, job.image.data(), job.compression);
+        lock.lock();
+
+        this->_failed = this->_failed || !succeeded;
+        this->_jobs.pop_front();
+        this->_changed.notify_all();
+    }
+}
+
+CS6620_NAMESPACE_END
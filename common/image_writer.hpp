@@ -0,0 +1,145 @@
+/**
+ * \file image_writer.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * Write the 8-bit RGB images to .ppm or .png files, optionally on a
+ * background thread, or stream them to a .ppm file a band of rows at a time.
+ */
+
+#ifndef IMAGE_WRITER_HPP
+#define IMAGE_WRITER_HPP
+
+#include "common.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * The speed against size trade-off of the .png files.
+ */
+enum class PNGCompression
+{
+    STORED, /**< No filtering and no deflate. About the size of a .ppm file, but the fastest. */
+    FAST,   /**< Fixed row filters and fixed Huffman codes with a short LZ77 window, for previews. */
+    BEST,   /**< The adaptive row filters and the full deflate, for finals. */
+};
+
+/**
+ * Parse the name of a PNG compression, i.e., "stored", "fast" or "best".
+ * @return true if the name is known.
+ */
+extern bool ParsePNGCompression(const char *name, PNGCompression &out_compression);
+
+/**
+ * Write an RGB8 image to a .png file.
+ * @return true if it succeeds.
+ */
+extern bool WritePNG(const char *filename, u32 width, u32 height, const u8 *image, PNGCompression compression) noexcept;
+
+/**
+ * Write the images in the format given by the file extension, i.e., .png
+ * or otherwise .ppm. The asynchronous writes are queued to a background
+ * thread and done in order, so a later write of the same file wins.
+ *
+ * An image may also be streamed to a .ppm file: beginStream() writes the
+ * header, the rows follow in bands through appendAsync() in order from the
+ * top, and endStream() closes the file. Only the queued bands are held in
+ * memory, never the whole image.
+ */
+class ImageWriter
+{
+public:
+    static const u32 MAX_PENDING = 2; /**< The queued writes beyond which write() waits. */
+
+public:
+    /**
+     * Constructor.
+     */
+    explicit ImageWriter();
+    /**
+     * Destructor. Finish the queued writes.
+     */
+    ~ImageWriter();
+
+    ImageWriter(const ImageWriter &) = delete;
+    ImageWriter &operator=(const ImageWriter &) = delete;
+    /**
+     * Write an image right away.
+     * @return true if it succeeds.
+     */
+    bool write(const char *filename, u32 width, u32 height, const u8 *image, PNGCompression compression) noexcept;
+    /**
+     * Queue an image to write on the background thread. Waits if there are
+     * MAX_PENDING writes queued already.
+     * @param image the RGB8 pixels, taken over by the writer.
+     */
+    void writeAsync(const char *filename, u32 width, u32 height, std::vector<u8> &&image, PNGCompression compression) noexcept;
+    /**
+     * Wait until all queued writes are done.
+     * @return true if all of them succeeded since the last wait.
+     */
+    bool wait() noexcept;
+    /**
+     * Start streaming an image to a .ppm file and write its header. Only
+     * one stream may be open at a time.
+     * @return true if the file is created.
+     */
+    bool beginStream(const char *filename, u32 width, u32 height) noexcept;
+    /**
+     * Queue the next rows of the streamed image to append on the background
+     * thread. Waits if there are MAX_PENDING writes queued already.
+     * @param rows the RGB8 pixels of whole rows, taken over by the writer.
+     */
+    void appendAsync(std::vector<u8> &&rows) noexcept;
+    /**
+     * Wait for the queued rows and close the streamed file.
+     * @return true if all rows of the image are written.
+     */
+    bool endStream() noexcept;
+
+private:
+    struct Job
+    {
+        std::string     filename;
+        u32             width;
+        u32             height;
+        std::vector<u8> image;
+        PNGCompression  compression;
+        bool            append = false; /**< The image is the next rows of the stream. */
+    };
+
+    void _push(Job &&job) noexcept;
+    /**
+     * Append the rows of a job to the stream.
+     */
+    bool _append(const Job &job) noexcept;
+    void _work() noexcept;
+
+private:
+    std::thread             _thread;        /**< Started by the first asynchronous write. */
+    std::mutex              _mutex;
+    std::condition_variable _changed;       /**< Signals a queued, finished or exit. */
+    std::deque<Job>         _jobs;          /**< The front one is being written. */
+    bool                    _failed = false;
+    bool                    _exit = false;
+
+    FILE                   *_stream = nullptr; /**< The streamed .ppm file, if open. */
+    std::string             _streamFilename;
+    u32                     _streamWidth = 0;
+    u32                     _streamHeight = 0;
+    u32                     _streamRows = 0;   /**< The rows written so far, by the background thread. */
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !IMAGE_WRITER_HPP
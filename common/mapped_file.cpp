@@ -0,0 +1,124 @@
+/**
+ * \file mapped_file.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * A read-only memory mapped file.
+ */
+
+#include "mapped_file.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CS6620_NAMESPACE_BEGIN
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::~MappedFile()
+{
+    this->close();
+}
+
+bool MappedFile::open(const char *file) noexcept
+{
+    this->close();
+
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        LOG(ERROR) << "Fail to open '" << file << "'.";
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+    {
+        LOG(ERROR) << "Fail to map the empty file '" << file << "'.";
+        CloseHandle(handle);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void *data = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (data == nullptr)
+    {
+        LOG(ERROR) << "Fail to map '" << file << "'.";
+        if (mapping != nullptr)
+        {
+            CloseHandle(mapping);
+        }
+        CloseHandle(handle);
+        return false;
+    }
+
+    this->_file = handle;
+    this->_mapping = mapping;
+    this->_data = (const u8 *)data;
+    this->_size = (size_t)size.QuadPart;
+#else
+    int fd = ::open(file, O_RDONLY);
+    if (fd < 0)
+    {
+        LOG(ERROR) << "Fail to open '" << file << "'.";
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0)
+    {
+        LOG(ERROR) << "Fail to map the empty file '" << file << "'.";
+        ::close(fd);
+        return false;
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    void *data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        LOG(ERROR) << "Fail to map '" << file << "'.";
+        return false;
+    }
+
+    this->_data = (const u8 *)data;
+    this->_size = (size_t)status.st_size;
+#endif
+
+    return true;
+}
+
+void MappedFile::close() noexcept
+{
+    if (this->_data == nullptr)
+    {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(this->_data);
+    CloseHandle((HANDLE)this->_mapping);
+    CloseHandle((HANDLE)this->_file);
+    this->_mapping = nullptr;
+    this->_file = nullptr;
+#else
+    munmap((void *)this->_data, this->_size);
+#endif
+
+    this->_data = nullptr;
+    this->_size = 0;
+}
+
+CS6620_NAMESPACE_END
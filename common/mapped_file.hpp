@@ -0,0 +1,64 @@
+/**
+ * \file mapped_file.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * A read-only memory mapped file.
+ */
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include "common.h"
+
+#include <cstddef>
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * Map a whole file into memory for reading. The pages are loaded by the OS
+ * on demand, so nothing is read until it's touched.
+ */
+class MappedFile
+{
+public:
+    /**
+     * Constructor.
+     */
+    explicit MappedFile();
+    /**
+     * Destructor. Unmap the file.
+     */
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    /**
+     * Map a file. The previously mapped one is unmapped.
+     * @param file the file path.
+     * @return true if it succeeds.
+     */
+    bool open(const char *file) noexcept;
+    /**
+     * Unmap the file.
+     */
+    void close() noexcept;
+
+    const u8 *data() const { return this->_data; }
+
+    size_t size() const { return this->_size; }
+
+private:
+    const u8 *_data = nullptr;
+    size_t    _size = 0;
+#if defined(_WIN32)
+    void     *_file = nullptr;    /**< The file handle. */
+    void     *_mapping = nullptr; /**< The file mapping handle. */
+#endif
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !MAPPED_FILE_HPP
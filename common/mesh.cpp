@@ -0,0 +1,325 @@
+/**
+ * \file mesh.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The triangle mesh with its own acceleration structure.
+ */
+
+#include "mesh.hpp"
+
+#include "cyTriMesh.h"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+CS6620_NAMESPACE_BEGIN
+
+std::shared_ptr<TriangleMesh> TriangleMesh::acquire(const char *objFile) noexcept
+{
+    // The loaded meshes. Only weak references are kept so a mesh is freed
+    // with the last node using it.
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<TriangleMesh>> meshes;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::shared_ptr<TriangleMesh> mesh = meshes[objFile].lock();
+    if (mesh == nullptr)
+    {
+        mesh = std::make_shared<TriangleMesh>();
+        if (!mesh->load(objFile))
+        {
+            meshes.erase(objFile);
+            return nullptr;
+        }
+
+        meshes[objFile] = mesh;
+    }
+
+    return mesh;
+}
+
+TriangleMesh::TriangleMesh()
+{
+}
+
+TriangleMesh::~TriangleMesh()
+{
+}
+
+bool TriangleMesh::load(const char *objFile) noexcept
+{
+    CS6620_PROFILE_SCOPE("Mesh load");
+
+    cy::TriMesh mesh;
+
+    std::ostringstream messages;
+    if (!mesh.LoadFromFileObj(objFile, false, &messages))
+    {
+        LOG(ERROR) << "Fail to load '" << objFile << "'. " << messages.str();
+        return false;
+    }
+
+    u32 numVertices = mesh.NV();
+    this->_x.resize(numVertices);
+    this->_y.resize(numVertices);
+    this->_z.resize(numVertices);
+    for (u32 i = 0; i < numVertices; ++i)
+    {
+        this->_x[i] = mesh.V(i).x;
+        this->_y[i] = mesh.V(i).y;
+        this->_z[i] = mesh.V(i).z;
+    }
+
+    u32 numFaces = mesh.NF();
+    this->_faces.resize(numFaces * 3);
+    for (u32 i = 0; i < numFaces; ++i)
+    {
+        this->_faces[i * 3 + 0] = mesh.F(i).v[0];
+        this->_faces[i * 3 + 1] = mesh.F(i).v[1];
+        this->_faces[i * 3 + 2] = mesh.F(i).v[2];
+    }
+
+    this->_file = objFile;
+    this->_useOwned();
+    this->_updateBounds();
+
+    LOG(INFO) << "Loaded '" << objFile << "' with " << numVertices << " vertices and " << numFaces << " faces.";
+
+    return true;
+}
+
+void TriangleMesh::map(const char *objFile, const f32 *x, const f32 *y, const f32 *z, u32 numVertices,
+    const u32 *faces, u32 numFaces, const BVH &bvh, std::shared_ptr<const void> owner) noexcept
+{
+    std::vector<f32>().swap(this->_x);
+    std::vector<f32>().swap(this->_y);
+    std::vector<f32>().swap(this->_z);
+    std::vector<u32>().swap(this->_faces);
+
+    this->_file = objFile;
+    this->_px = x;
+    this->_py = y;
+    this->_pz = z;
+    this->_pfaces = faces;
+    this->_numVertices = numVertices;
+    this->_numFaces = numFaces;
+    this->_mapping = owner;
+    this->_bvh = bvh;
+
+    this->_updateBounds();
+}
+
+void TriangleMesh::_useOwned() noexcept
+{
+    this->_px = this->_x.data();
+    this->_py = this->_y.data();
+    this->_pz = this->_z.data();
+    this->_pfaces = this->_faces.data();
+    this->_numVertices = (u32)this->_x.size();
+    this->_numFaces = (u32)this->_faces.size() / 3;
+    this->_mapping = nullptr;
+}
+
+void TriangleMesh::_updateBounds() noexcept
+{
+    this->_bounds = AABB();
+    for (u32 i = 0; i < this->numVertices(); ++i)
+    {
+        this->_bounds.grow(this->_vertex(i));
+    }
+}
+
+void TriangleMesh::build(const BVHCache *cache, ThreadPool *pool) noexcept
+{
+    if (this->built())
+    {
+        return;
+    }
+
+    // The faces are reordered, so a mapped mesh gets its own copy first.
+    if (this->_mapping != nullptr)
+    {
+        this->_x.assign(this->_px, this->_px + this->_numVertices);
+        this->_y.assign(this->_py, this->_py + this->_numVertices);
+        this->_z.assign(this->_pz, this->_pz + this->_numVertices);
+        this->_faces.assign(this->_pfaces, this->_pfaces + this->_numFaces * 3);
+        this->_useOwned();
+    }
+
+    u32 numFaces = this->numFaces();
+
+    // The BVH only depends on the vertices and the faces in their original
+    // order, which is what the cached one was built from.
+    u64 key = 0;
+    if (cache != nullptr)
+    {
+        key = BVHCache::hash(&this->_numVertices, sizeof(u32));
+        key = BVHCache::hash(this->_x.data(), this->_x.size() * sizeof(f32), key);
+        key = BVHCache::hash(this->_y.data(), this->_y.size() * sizeof(f32), key);
+        key = BVHCache::hash(this->_z.data(), this->_z.size() * sizeof(f32), key);
+        key = BVHCache::hash(this->_faces.data(), this->_faces.size() * sizeof(u32), key);
+    }
+
+    if (cache == nullptr || !cache->load(key, numFaces, this->_bvh))
+    {
+        std::vector<AABB> bounds(numFaces);
+        for (u32 i = 0; i < numFaces; ++i)
+        {
+            bounds[i].grow(this->_vertex(this->_faces[i * 3 + 0]));
+            bounds[i].grow(this->_vertex(this->_faces[i * 3 + 1]));
+            bounds[i].grow(this->_vertex(this->_faces[i * 3 + 2]));
+        }
+
+        this->_bvh.buildBinned(bounds, 4, pool);
+
+        if (cache != nullptr)
+        {
+            cache->save(key, this->_bvh);
+        }
+    }
+
+    // Reorder the faces by the leaves so a leaf's range indexes them directly.
+    const u32 *order = this->_bvh.indices();
+    std::vector<u32> faces(this->_faces.size());
+    for (u32 i = 0; i < numFaces; ++i)
+    {
+        faces[i * 3 + 0] = this->_faces[order[i] * 3 + 0];
+        faces[i * 3 + 1] = this->_faces[order[i] * 3 + 1];
+        faces[i * 3 + 2] = this->_faces[order[i] * 3 + 2];
+    }
+    this->_faces.swap(faces);
+    this->_useOwned();
+}
+
+bool TriangleMesh::intersect(const Ray &ray, f32 &inout_distance, u32 &out_face) const noexcept
+{
+    return this->_intersect<false>(ray, inout_distance, out_face);
+}
+
+bool TriangleMesh::occluded(const Ray &ray, f32 tmax) const noexcept
+{
+    u32 face;
+    return this->_intersect<true>(ray, tmax, face);
+}
+
+template <bool ANY_HIT>
+bool TriangleMesh::_intersect(const Ray &ray, f32 &inout_distance, u32 &out_face) const noexcept
+{
+    if (this->_numFaces == 0)
+    {
+        return false;
+    }
+
+    // The watertight ray-triangle test of Woop et al. 2013. The vertices are
+    // moved into a space where the ray starts at the origin and goes along
+    // +z, so the test reduces to 2D edge functions, which never let a ray
+    // slip through a shared edge.
+    const vec3 &d = ray.direction;
+
+    i32 kz = d.Abs().MaxIndex();
+    i32 kx = (kz + 1) % 3;
+    i32 ky = (kx + 1) % 3;
+    if (d[kz] < 0.0f)
+    {
+        std::swap(kx, ky);
+    }
+
+    f32 sx = d[kx] / d[kz];
+    f32 sy = d[ky] / d[kz];
+    f32 sz = 1.0f / d[kz];
+
+    const f32 *position[3] = { this->_px, this->_py, this->_pz };
+
+    auto intersectLeaf = [&](u32 first, u32 count, f32 &tmax)
+    {
+        bool hit = false;
+
+        CS6620_STATS_ADD(PRIMITIVE_TESTS, count);
+
+        for (u32 face = first; face < first + count; ++face)
+        {
+            u32 i0 = this->_pfaces[face * 3 + 0];
+            u32 i1 = this->_pfaces[face * 3 + 1];
+            u32 i2 = this->_pfaces[face * 3 + 2];
+
+            f32 akx = position[kx][i0] - ray.origin[kx];
+            f32 aky = position[ky][i0] - ray.origin[ky];
+            f32 akz = position[kz][i0] - ray.origin[kz];
+            f32 bkx = position[kx][i1] - ray.origin[kx];
+            f32 bky = position[ky][i1] - ray.origin[ky];
+            f32 bkz = position[kz][i1] - ray.origin[kz];
+            f32 ckx = position[kx][i2] - ray.origin[kx];
+            f32 cky = position[ky][i2] - ray.origin[ky];
+            f32 ckz = position[kz][i2] - ray.origin[kz];
+
+            f32 ax = akx - sx * akz;
+            f32 ay = aky - sy * akz;
+            f32 bx = bkx - sx * bkz;
+            f32 by = bky - sy * bkz;
+            f32 cx = ckx - sx * ckz;
+            f32 cy = cky - sy * ckz;
+
+            f32 u = cx * by - cy * bx;
+            f32 v = ax * cy - ay * cx;
+            f32 w = bx * ay - by * ax;
+
+            // Fall back to double precision on the edges.
+            if (u == 0.0f || v == 0.0f || w == 0.0f)
+            {
+                u = (f32)((f64)cx * (f64)by - (f64)cy * (f64)bx);
+                v = (f32)((f64)ax * (f64)cy - (f64)ay * (f64)cx);
+                w = (f32)((f64)bx * (f64)ay - (f64)by * (f64)ax);
+            }
+
+            if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+            {
+                continue;
+            }
+
+            f32 det = u + v + w;
+            if (det == 0.0f)
+            {
+                continue;
+            }
+
+            f32 t = (u * sz * akz + v * sz * bkz + w * sz * ckz) / det;
+            if (t > RAY_EPSILON && t < tmax)
+            {
+                tmax = t;
+                out_face = face;
+                hit = true;
+
+                if (ANY_HIT)
+                {
+                    break;
+                }
+            }
+        }
+
+        return hit;
+    };
+
+    if (ANY_HIT)
+    {
+        return this->_bvh.occluded(ray, inout_distance, intersectLeaf);
+    }
+    return this->_bvh.intersect(ray, inout_distance, intersectLeaf);
+}
+
+vec3 TriangleMesh::normal(u32 face) const noexcept
+{
+    vec3 a = this->_vertex(this->_pfaces[face * 3 + 0]);
+    vec3 b = this->_vertex(this->_pfaces[face * 3 + 1]);
+    vec3 c = this->_vertex(this->_pfaces[face * 3 + 2]);
+
+    return (b - a).Cross(c - a).GetNormalized();
+}
+
+CS6620_NAMESPACE_END
@@ -0,0 +1,158 @@
+/**
+ * \file mesh.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The triangle mesh with its own acceleration structure.
+ */
+
+#ifndef MESH_HPP
+#define MESH_HPP
+
+#include "common.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "bvh_cache.hpp"
+#include "ray.hpp"
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * A triangle mesh. The vertex positions are stored component by component
+ * and the faces are kept in the order of the BVH leaves, so a leaf refers
+ * to a contiguous range of faces.
+ *
+ * The mesh stays in its object space so that the nodes referring to the same
+ * file share one copy of it, together with its BVH, and only keep their own
+ * transforms. The arrays are either owned by the mesh or, for a mesh from a
+ * snapshot, mapped from the file.
+ */
+class TriangleMesh
+{
+public:
+    /**
+     * Get the mesh of an .obj file, loading it if no one holds it yet.
+     * @param objFile the .obj file path.
+     * @return the shared mesh, or nullptr if load fails.
+     */
+    static std::shared_ptr<TriangleMesh> acquire(const char *objFile) noexcept;
+
+public:
+    /**
+     * Constructor.
+     */
+    explicit TriangleMesh();
+    /**
+     * Destructor.
+     */
+    ~TriangleMesh();
+
+    TriangleMesh(const TriangleMesh &) = delete;
+    TriangleMesh &operator=(const TriangleMesh &) = delete;
+    /**
+     * Load the mesh from an .obj file. Polygons are split into triangles.
+     * @param objFile the .obj file path.
+     * @return true if load succeeds.
+     */
+    bool load(const char *objFile) noexcept;
+    /**
+     * Use the arrays of a mesh saved before without copying them.
+     * @param objFile the .obj file the mesh was loaded from.
+     * @param x, y, z the vertex positions.
+     * @param faces three vertex indices per face.
+     * @param bvh the hierarchy over the faces, which may be empty.
+     * @param owner keeps the memory of the arrays alive.
+     */
+    void map(const char *objFile, const f32 *x, const f32 *y, const f32 *z, u32 numVertices,
+        const u32 *faces, u32 numFaces, const BVH &bvh, std::shared_ptr<const void> owner) noexcept;
+    /**
+     * Build the BVH over the faces and reorder the faces by its leaves.
+     * Does nothing if it's built already.
+     * @param cache the cache to look the BVH up in before building it, and
+     * to save the built one to. Optional.
+     * @param pool the threads to build with. Optional.
+     */
+    void build(const BVHCache *cache = nullptr, ThreadPool *pool = nullptr) noexcept;
+    /**
+     * Compute the nearest intersection with the ray.
+     * @param ray the ray.
+     * @param inout_distance the nearest hit distance so far. Updated on a closer hit.
+     * @param out_face return the hit face.
+     * @return true if there's a hit closer than inout_distance.
+     */
+    bool intersect(const Ray &ray, f32 &inout_distance, u32 &out_face) const noexcept;
+    /**
+     * If any face is hit by the ray closer than tmax, stopping at the first
+     * one found.
+     */
+    bool occluded(const Ray &ray, f32 tmax) const noexcept;
+    /**
+     * The unit length geometric normal of a face.
+     */
+    vec3 normal(u32 face) const noexcept;
+
+    AABB bounds() const { return this->_bounds; }
+
+    u32 numVertices() const { return this->_numVertices; }
+
+    u32 numFaces() const { return this->_numFaces; }
+
+    const f32 *x() const { return this->_px; }
+
+    const f32 *y() const { return this->_py; }
+
+    const f32 *z() const { return this->_pz; }
+
+    const u32 *faces() const { return this->_pfaces; }
+
+    const BVH &bvh() const { return this->_bvh; }
+
+    bool built() const { return this->_bvh.numNodes() > 0; }
+
+    const std::string &file() const { return this->_file; }
+
+private:
+    vec3 _vertex(u32 index) const { return vec3(this->_px[index], this->_py[index], this->_pz[index]); }
+
+    void _updateBounds() noexcept;
+    /**
+     * Point to the arrays owned by the mesh.
+     */
+    void _useOwned() noexcept;
+    /**
+     * The ray-face intersection, either of the nearest face or of any face
+     * for occluded().
+     */
+    template <bool ANY_HIT>
+    bool _intersect(const Ray &ray, f32 &inout_distance, u32 &out_face) const noexcept;
+
+private:
+    std::vector<f32> _x;     /**< The vertex positions. */
+    std::vector<f32> _y;
+    std::vector<f32> _z;
+    std::vector<u32> _faces; /**< Three vertex indices per face. */
+    AABB             _bounds;
+    BVH              _bvh;
+    std::string      _file;
+
+    // The arrays in use, either the above or the mapped ones.
+    const f32 *_px = nullptr;
+    const f32 *_py = nullptr;
+    const f32 *_pz = nullptr;
+    const u32 *_pfaces = nullptr;
+    u32        _numVertices = 0;
+    u32        _numFaces = 0;
+
+    std::shared_ptr<const void> _mapping;
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !MESH_HPP
@@ -0,0 +1,365 @@
+/**
+ * \file packet.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The SIMD lanes, the 3D vectors of them and the packets of rays and hits
+ * built on them.
+ */
+
+#ifndef PACKET_HPP
+#define PACKET_HPP
+
+#include "common.h"
+
+#include "ray.hpp"
+
+#include <cfloat>
+#include <cmath>
+
+#if defined(CS6620_SSE2)
+#include <immintrin.h>
+#endif
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * N values of type T, one per lane, with the element-wise arithmetic on
+ * them. This generic one is a plain array that the compiler may vectorize
+ * by itself. Lanes<f32, 4> with SSE2 and Lanes<f32, 8> with AVX2 below
+ * are specialized to hold a register, so a width is picked at compile
+ * time and the code above it stays the same.
+ */
+template <typename T, int N>
+struct Lanes
+{
+    T v[N];
+
+    Lanes() {}
+    explicit Lanes(T s) { for (int i = 0; i < N; ++i) this->v[i] = s; }
+
+    static Lanes load(const T *p) { Lanes r; for (int i = 0; i < N; ++i) r.v[i] = p[i]; return r; }
+    void store(T *p) const { for (int i = 0; i < N; ++i) p[i] = this->v[i]; }
+
+    T operator[](int i) const { return this->v[i]; }
+    void set(int i, T s) { this->v[i] = s; }
+};
+
+/**
+ * The result of a comparison of the lanes, true or false per lane.
+ */
+template <typename T, int N>
+struct LaneMask
+{
+    bool v[N];
+
+    LaneMask() {}
+    explicit LaneMask(bool s) { for (int i = 0; i < N; ++i) this->v[i] = s; }
+
+    bool operator[](int i) const { return this->v[i]; }
+    /**
+     * The lanes as bits, the first lane in the lowest bit.
+     */
+    u32 bits() const { u32 r = 0; for (int i = 0; i < N; ++i) r |= (u32)this->v[i] << i; return r; }
+    bool any() const { return this->bits() != 0; }
+    bool all() const { return this->bits() == (N == 32 ? ~0u : (1u << N) - 1); }
+    bool none() const { return this->bits() == 0; }
+};
+
+#define CS6620_LANES_BINARY(OP) \
+    template <typename T, int N> inline Lanes<T, N> operator OP(const Lanes<T, N> &a, const Lanes<T, N> &b) \
+    { Lanes<T, N> r; for (int i = 0; i < N; ++i) r.v[i] = a.v[i] OP b.v[i]; return r; }
+#define CS6620_LANES_COMPARE(OP) \
+    template <typename T, int N> inline LaneMask<T, N> operator OP(const Lanes<T, N> &a, const Lanes<T, N> &b) \
+    { LaneMask<T, N> r; for (int i = 0; i < N; ++i) r.v[i] = a.v[i] OP b.v[i]; return r; }
+#define CS6620_MASK_BINARY(OP) \
+    template <typename T, int N> inline LaneMask<T, N> operator OP(const LaneMask<T, N> &a, const LaneMask<T, N> &b) \
+    { LaneMask<T, N> r; for (int i = 0; i < N; ++i) r.v[i] = a.v[i] OP b.v[i]; return r; }
+
+CS6620_LANES_BINARY(+)
+CS6620_LANES_BINARY(-)
+CS6620_LANES_BINARY(*)
+CS6620_LANES_BINARY(/)
+CS6620_LANES_COMPARE(<)
+CS6620_LANES_COMPARE(<=)
+CS6620_LANES_COMPARE(>)
+CS6620_LANES_COMPARE(>=)
+CS6620_LANES_COMPARE(==)
+CS6620_MASK_BINARY(&)
+CS6620_MASK_BINARY(|)
+
+template <typename T, int N> inline LaneMask<T, N> operator~(const LaneMask<T, N> &a)
+{ LaneMask<T, N> r; for (int i = 0; i < N; ++i) r.v[i] = !a.v[i]; return r; }
+template <typename T, int N> inline Lanes<T, N> operator-(const Lanes<T, N> &a)
+{ Lanes<T, N> r; for (int i = 0; i < N; ++i) r.v[i] = -a.v[i]; return r; }
+
+/**
+ * a where the mask is true and b elsewhere.
+ */
+template <typename T, int N> inline Lanes<T, N> Select(const LaneMask<T, N> &mask, const Lanes<T, N> &a, const Lanes<T, N> &b)
+{ Lanes<T, N> r; for (int i = 0; i < N; ++i) r.v[i] = mask.v[i] ? a.v[i] : b.v[i]; return r; }
+/**
+ * Min() and Max() return b where either is NaN, as the SSE instructions do.
+ */
+template <typename T, int N> inline Lanes<T, N> Min(const Lanes<T, N> &a, const Lanes<T, N> &b)
+{ Lanes<T, N> r; for (int i = 0; i < N; ++i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+template <typename T, int N> inline Lanes<T, N> Max(const Lanes<T, N> &a, const Lanes<T, N> &b)
+{ Lanes<T, N> r; for (int i = 0; i < N; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+template <typename T, int N> inline Lanes<T, N> Sqrt(const Lanes<T, N> &a)
+{ Lanes<T, N> r; for (int i = 0; i < N; ++i) r.v[i] = std::sqrt(a.v[i]); return r; }
+/**
+ * 1 / Sqrt(a). The SIMD ones refine the hardware estimate by a Newton step
+ * to about 22 bits, so it isn't exact to the last bit as Sqrt() is.
+ */
+template <typename T, int N> inline Lanes<T, N> Rsqrt(const Lanes<T, N> &a)
+{ Lanes<T, N> r; for (int i = 0; i < N; ++i) r.v[i] = T(1) / std::sqrt(a.v[i]); return r; }
+
+#undef CS6620_LANES_BINARY
+#undef CS6620_LANES_COMPARE
+#undef CS6620_MASK_BINARY
+
+#if defined(CS6620_SSE2)
+template <>
+struct Lanes<f32, 4>
+{
+    __m128 v;
+
+    Lanes() {}
+    Lanes(__m128 m) : v(m) {}
+    explicit Lanes(f32 s) : v(_mm_set1_ps(s)) {}
+
+    static Lanes load(const f32 *p) { return _mm_loadu_ps(p); }
+    void store(f32 *p) const { _mm_storeu_ps(p, this->v); }
+
+    f32 operator[](int i) const { alignas(16) f32 a[4]; _mm_store_ps(a, this->v); return a[i]; }
+    void set(int i, f32 s) { alignas(16) f32 a[4]; _mm_store_ps(a, this->v); a[i] = s; this->v = _mm_load_ps(a); }
+};
+
+template <>
+struct LaneMask<f32, 4>
+{
+    __m128 v; /**< All bits set in the true lanes. */
+
+    LaneMask() {}
+    LaneMask(__m128 m) : v(m) {}
+    explicit LaneMask(bool s) : v(_mm_castsi128_ps(_mm_set1_epi32(s ? -1 : 0))) {}
+
+    bool operator[](int i) const { return (this->bits() >> i & 1) != 0; }
+    u32 bits() const { return (u32)_mm_movemask_ps(this->v); }
+    bool any() const { return this->bits() != 0; }
+    bool all() const { return this->bits() == 0xf; }
+    bool none() const { return this->bits() == 0; }
+};
+
+inline Lanes<f32, 4> operator+(const Lanes<f32, 4> &a, const Lanes<f32, 4> &b) { return _mm_add_ps(a.v, b.v); }
+inline Lanes<f32, 4> operator-(const Lanes<f32, 4> &a, const Lanes<f32, 4> &b) { return _mm_sub_ps(a.v, b.v); }
+inline Lanes<f32, 4> operator*(const Lanes<f32, 4> &a, const Lanes<f32, 4> &b) { return _mm_mul_ps(a.v, b.v); }
+inline Lanes<f32, 4> operator/(const Lanes<f32, 4> &a, const Lanes<f32, 4> &b) { return _mm_div_ps(a.v, b.v); }
+inline Lanes<f32, 4> operator-(const Lanes<f32, 4> &a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+inline LaneMask<f32, 4> operator<(const Lanes<f32, 4> &a, const Lanes<f32, 4> &b) { return _mm_cmplt_ps(a.v, b.v); }
+inline LaneMask<f32, 4> operator<=(const Lanes<f32, 4> &a, const Lanes<f32, 4> &b) { return _mm_cmple_ps(a.v, b.v); }
+inline LaneMask<f32, 4> operator>(const Lanes<f32, 4> &a, const Lanes<f32, 4> &b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline LaneMask<f32, 4> operator>=(const Lanes<f32, 4> &a, const Lanes<f32, 4> &b) { return _mm_cmpge_ps(a.v, b.v); }
+inline LaneMask<f32, 4> operator==(const Lanes<f32, 4> &a, const Lanes<f32, 4> &b) { return _mm_cmpeq_ps(a.v, b.v); }
+inline LaneMask<f32, 4> operator&(const LaneMask<f32, 4> &a, const LaneMask<f32, 4> &b) { return _mm_and_ps(a.v, b.v); }
+inline LaneMask<f32, 4> operator|(const LaneMask<f32, 4> &a, const LaneMask<f32, 4> &b) { return _mm_or_ps(a.v, b.v); }
+inline LaneMask<f32, 4> operator~(const LaneMask<f32, 4> &a) { return _mm_xor_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+
+inline Lanes<f32, 4> Select(const LaneMask<f32, 4> &mask, const Lanes<f32, 4> &a, const Lanes<f32, 4> &b)
+{
+    return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+inline Lanes<f32, 4> Min(const Lanes<f32, 4> &a, const Lanes<f32, 4> &b) { return _mm_min_ps(a.v, b.v); }
+inline Lanes<f32, 4> Max(const Lanes<f32, 4> &a, const Lanes<f32, 4> &b) { return _mm_max_ps(a.v, b.v); }
+inline Lanes<f32, 4> Sqrt(const Lanes<f32, 4> &a) { return _mm_sqrt_ps(a.v); }
+inline Lanes<f32, 4> Rsqrt(const Lanes<f32, 4> &a)
+{
+    __m128 y = _mm_rsqrt_ps(a.v);
+    __m128 yy = _mm_mul_ps(_mm_mul_ps(y, y), _mm_mul_ps(a.v, _mm_set1_ps(0.5f)));
+    return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), yy));
+}
+#endif
+
+#if defined(CS6620_AVX2)
+template <>
+struct Lanes<f32, 8>
+{
+    __m256 v;
+
+    Lanes() {}
+    Lanes(__m256 m) : v(m) {}
+    explicit Lanes(f32 s) : v(_mm256_set1_ps(s)) {}
+
+    static Lanes load(const f32 *p) { return _mm256_loadu_ps(p); }
+    void store(f32 *p) const { _mm256_storeu_ps(p, this->v); }
+
+    f32 operator[](int i) const { alignas(32) f32 a[8]; _mm256_store_ps(a, this->v); return a[i]; }
+    void set(int i, f32 s) { alignas(32) f32 a[8]; _mm256_store_ps(a, this->v); a[i] = s; this->v = _mm256_load_ps(a); }
+};
+
+template <>
+struct LaneMask<f32, 8>
+{
+    __m256 v; /**< All bits set in the true lanes. */
+
+    LaneMask() {}
+    LaneMask(__m256 m) : v(m) {}
+    explicit LaneMask(bool s) : v(_mm256_castsi256_ps(_mm256_set1_epi32(s ? -1 : 0))) {}
+
+    bool operator[](int i) const { return (this->bits() >> i & 1) != 0; }
+    u32 bits() const { return (u32)_mm256_movemask_ps(this->v); }
+    bool any() const { return this->bits() != 0; }
+    bool all() const { return this->bits() == 0xff; }
+    bool none() const { return this->bits() == 0; }
+};
+
+inline Lanes<f32, 8> operator+(const Lanes<f32, 8> &a, const Lanes<f32, 8> &b) { return _mm256_add_ps(a.v, b.v); }
+inline Lanes<f32, 8> operator-(const Lanes<f32, 8> &a, const Lanes<f32, 8> &b) { return _mm256_sub_ps(a.v, b.v); }
+inline Lanes<f32, 8> operator*(const Lanes<f32, 8> &a, const Lanes<f32, 8> &b) { return _mm256_mul_ps(a.v, b.v); }
+inline Lanes<f32, 8> operator/(const Lanes<f32, 8> &a, const Lanes<f32, 8> &b) { return _mm256_div_ps(a.v, b.v); }
+inline Lanes<f32, 8> operator-(const Lanes<f32, 8> &a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline LaneMask<f32, 8> operator<(const Lanes<f32, 8> &a, const Lanes<f32, 8> &b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline LaneMask<f32, 8> operator<=(const Lanes<f32, 8> &a, const Lanes<f32, 8> &b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline LaneMask<f32, 8> operator>(const Lanes<f32, 8> &a, const Lanes<f32, 8> &b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline LaneMask<f32, 8> operator>=(const Lanes<f32, 8> &a, const Lanes<f32, 8> &b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline LaneMask<f32, 8> operator==(const Lanes<f32, 8> &a, const Lanes<f32, 8> &b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+inline LaneMask<f32, 8> operator&(const LaneMask<f32, 8> &a, const LaneMask<f32, 8> &b) { return _mm256_and_ps(a.v, b.v); }
+inline LaneMask<f32, 8> operator|(const LaneMask<f32, 8> &a, const LaneMask<f32, 8> &b) { return _mm256_or_ps(a.v, b.v); }
+inline LaneMask<f32, 8> operator~(const LaneMask<f32, 8> &a) { return _mm256_xor_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+
+inline Lanes<f32, 8> Select(const LaneMask<f32, 8> &mask, const Lanes<f32, 8> &a, const Lanes<f32, 8> &b)
+{
+    return _mm256_blendv_ps(b.v, a.v, mask.v);
+}
+inline Lanes<f32, 8> Min(const Lanes<f32, 8> &a, const Lanes<f32, 8> &b) { return _mm256_min_ps(a.v, b.v); }
+inline Lanes<f32, 8> Max(const Lanes<f32, 8> &a, const Lanes<f32, 8> &b) { return _mm256_max_ps(a.v, b.v); }
+inline Lanes<f32, 8> Sqrt(const Lanes<f32, 8> &a) { return _mm256_sqrt_ps(a.v); }
+inline Lanes<f32, 8> Rsqrt(const Lanes<f32, 8> &a)
+{
+    __m256 y = _mm256_rsqrt_ps(a.v);
+    __m256 yy = _mm256_mul_ps(_mm256_mul_ps(y, y), _mm256_mul_ps(a.v, _mm256_set1_ps(0.5f)));
+    return _mm256_mul_ps(y, _mm256_sub_ps(_mm256_set1_ps(1.5f), yy));
+}
+#endif
+
+/**
+ * N 3D vectors stored component by component. The operations follow the
+ * order of the scalar cy::Vec3 ones, so a lane gives the same result as
+ * the scalar code on it.
+ */
+template <typename T, int N>
+struct Vec3xN
+{
+    typedef Lanes<T, N>    Scalar;
+    typedef LaneMask<T, N> Mask;
+
+    Scalar x, y, z;
+
+    Vec3xN() {}
+    Vec3xN(const Scalar &x_, const Scalar &y_, const Scalar &z_) : x(x_), y(y_), z(z_) {}
+    /**
+     * The same vector in all lanes.
+     */
+    explicit Vec3xN(const cy::Vec3<T> &p) : x(p.x), y(p.y), z(p.z) {}
+
+    cy::Vec3<T> get(int lane) const { return cy::Vec3<T>(this->x[lane], this->y[lane], this->z[lane]); }
+    void set(int lane, const cy::Vec3<T> &p) { this->x.set(lane, p.x); this->y.set(lane, p.y); this->z.set(lane, p.z); }
+
+    Vec3xN operator+(const Vec3xN &p) const { return Vec3xN(this->x + p.x, this->y + p.y, this->z + p.z); }
+    Vec3xN operator-(const Vec3xN &p) const { return Vec3xN(this->x - p.x, this->y - p.y, this->z - p.z); }
+    Vec3xN operator*(const Vec3xN &p) const { return Vec3xN(this->x * p.x, this->y * p.y, this->z * p.z); }
+    Vec3xN operator*(const Scalar &s) const { return Vec3xN(this->x * s, this->y * s, this->z * s); }
+    Vec3xN operator/(const Scalar &s) const { return Vec3xN(this->x / s, this->y / s, this->z / s); }
+    Vec3xN operator-() const { return Vec3xN(-this->x, -this->y, -this->z); }
+
+    Scalar Dot(const Vec3xN &p) const { return this->x * p.x + this->y * p.y + this->z * p.z; }
+    Vec3xN Cross(const Vec3xN &p) const
+    {
+        return Vec3xN(this->y * p.z - this->z * p.y, this->z * p.x - this->x * p.z, this->x * p.y - this->y * p.x);
+    }
+    Scalar LengthSquared() const { return this->Dot(*this); }
+    Scalar Length() const { return Sqrt(this->LengthSquared()); }
+    Vec3xN GetNormalized() const { return *this / this->Length(); }
+    void Normalize() { *this = this->GetNormalized(); }
+    /**
+     * Normalize with the approximate Rsqrt(), which is faster but not exact
+     * to the last bit.
+     */
+    Vec3xN GetNormalizedFast() const { return *this * Rsqrt(this->LengthSquared()); }
+};
+
+template <typename T, int N> inline Vec3xN<T, N> Select(const LaneMask<T, N> &mask, const Vec3xN<T, N> &a, const Vec3xN<T, N> &b)
+{
+    return Vec3xN<T, N>(Select(mask, a.x, b.x), Select(mask, a.y, b.y), Select(mask, a.z, b.z));
+}
+template <typename T, int N> inline Vec3xN<T, N> Min(const Vec3xN<T, N> &a, const Vec3xN<T, N> &b)
+{
+    return Vec3xN<T, N>(Min(a.x, b.x), Min(a.y, b.y), Min(a.z, b.z));
+}
+template <typename T, int N> inline Vec3xN<T, N> Max(const Vec3xN<T, N> &a, const Vec3xN<T, N> &b)
+{
+    return Vec3xN<T, N>(Max(a.x, b.x), Max(a.y, b.y), Max(a.z, b.z));
+}
+
+/**
+ * The widest packet the compiler flags enable.
+ */
+#if defined(CS6620_AVX2)
+const int PACKET_WIDTH = 8;
+#elif defined(CS6620_SSE2)
+const int PACKET_WIDTH = 4;
+#else
+const int PACKET_WIDTH = 1;
+#endif
+
+typedef Lanes<f32, PACKET_WIDTH>    f32xN;
+typedef LaneMask<f32, PACKET_WIDTH> maskxN;
+typedef Vec3xN<f32, PACKET_WIDTH>   vec3xN;
+
+/**
+ * N rays, one per lane. The inactive lanes, e.g., the ones past the end of
+ * a batch, are left out of the tests.
+ */
+template <int N>
+struct RayPacket
+{
+    Vec3xN<f32, N>   origin;
+    Vec3xN<f32, N>   direction;
+    LaneMask<f32, N> active;
+
+    RayPacket() : active(true) {}
+
+    Ray get(int lane) const
+    {
+        Ray ray;
+        ray.origin = this->origin.get(lane);
+        ray.direction = this->direction.get(lane);
+        return ray;
+    }
+    void set(int lane, const Ray &ray)
+    {
+        this->origin.set(lane, ray.origin);
+        this->direction.set(lane, ray.direction);
+    }
+};
+
+/**
+ * The nearest hits of a ray packet. The distance of a missed lane stays
+ * at FLT_MAX and its primitive and face are undefined.
+ */
+template <int N>
+struct HitPacket
+{
+    Lanes<f32, N>    distance;
+    LaneMask<f32, N> hit;
+    u32              primitive[N];
+    u32              face[N];
+
+    HitPacket() : distance(FLT_MAX), hit(false) {}
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !PACKET_HPP
@@ -92,23 +92,40 @@ ReadPPM(const char* filename, int* width, int* height)
 }
 
 /**
- * Write the image into an RGB .ppm file.
+ * Create an RGB .ppm file and write its header, leaving the pixels to the
+ * caller, row by row from the top.
  */
-bool
-WritePPM(const char* filename, int width, int height, const unsigned char *image)
+FILE*
+OpenPPM(const char* filename, int width, int height)
 {
     FILE* fp;
     
     fp = fopen(filename, "wb");
     if (!fp) {
         LOG(ERROR) << "Fail to write to " << filename;
-        return false;
+        return NULL;
     }
     
     /* Write the header */
     fprintf(fp, "P6\n");
     fprintf(fp, "%d %d %d", width, height, 255);
     
+    return fp;
+}
+
+/**
+ * Write the image into an RGB .ppm file.
+ */
+bool
+WritePPM(const char* filename, int width, int height, const unsigned char *image)
+{
+    FILE* fp;
+    
+    fp = OpenPPM(filename, width, height);
+    if (!fp) {
+        return false;
+    }
+    
     /* grab all the image data in one fell swoop. */
     fwrite(image, sizeof(unsigned char), width * height * 3, fp);
     fclose(fp);
@@ -10,11 +10,15 @@
 #ifndef PPM_H
 #define PPM_H
 
+#include <cstdio>
+
 
 extern unsigned char* ReadPPM(const char* filename, int* width, int* height);
 
 extern bool WritePPM(const char* filename, int width, int height, const unsigned char *image);
 
+extern FILE* OpenPPM(const char* filename, int width, int height);
+
 
 
 #endif // !PPM_H
@@ -0,0 +1,248 @@
+/**
+ * \file profiler.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The wall clock timer and the hierarchical scope profiler.
+ */
+
+#include "profiler.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define CS6620_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CS6620_RDTSC
+#endif
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * A scope in the tree of a thread. The tree is stored in an array and the
+ * nodes link to each other by indices.
+ */
+struct ProfileNode
+{
+    const char *name;
+    u32 parent;
+    u32 firstChild = NONE;
+    u32 nextSibling = NONE;
+    u64 ticks = 0;     /**< The total ticks spent in the scope. */
+    u64 calls = 0;
+    u64 start = 0;     /**< When the scope was entered the last time. */
+
+    static const u32 NONE = 0xffffffff;
+};
+
+/**
+ * The scopes of a thread. Node 0 is the root, which is never timed.
+ */
+struct ProfileThread
+{
+    std::vector<ProfileNode> nodes;
+    u32 current = 0;
+};
+
+/**
+ * The scopes merged from all threads.
+ */
+struct ProfileReportNode
+{
+    const char *name;
+    u64 ticks = 0;
+    u64 calls = 0;
+    u32 threads = 0;
+    std::vector<ProfileReportNode> children;
+};
+
+/**
+ * All threads' scopes. They're never freed so that the report can still see
+ * the threads that have exited.
+ */
+static std::mutex _profileMutex;
+static std::vector<ProfileThread *> _profileThreads;
+
+static thread_local ProfileThread *_profileThread = nullptr;
+
+// The anchors to convert the ticks to seconds.
+static u64 _startTicks = Profiler::ticks();
+static std::chrono::steady_clock::time_point _startTime = std::chrono::steady_clock::now();
+
+static void _ReportAtExit()
+{
+    Profiler::report();
+}
+
+static ProfileThread *_GetProfileThread() noexcept
+{
+    if (_profileThread == nullptr)
+    {
+        _profileThread = new ProfileThread();
+
+        ProfileNode root;
+        root.name = "";
+        root.parent = ProfileNode::NONE;
+        _profileThread->nodes.push_back(root);
+
+        std::lock_guard<std::mutex> lock(_profileMutex);
+        if (_profileThreads.empty())
+        {
+            atexit(_ReportAtExit);
+        }
+        _profileThreads.push_back(_profileThread);
+    }
+
+    return _profileThread;
+}
+
+u64 Profiler::ticks() noexcept
+{
+#if defined(CS6620_RDTSC)
+    return (u64)__rdtsc();
+#else
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void Profiler::begin(const char *name) noexcept
+{
+    ProfileThread *thread = _GetProfileThread();
+    std::vector<ProfileNode> &nodes = thread->nodes;
+
+    // Find the scope among the children of the current one, otherwise add it.
+    u32 node = nodes[thread->current].firstChild;
+    while (node != ProfileNode::NONE && nodes[node].name != name && strcmp(nodes[node].name, name) != 0)
+    {
+        node = nodes[node].nextSibling;
+    }
+
+    if (node == ProfileNode::NONE)
+    {
+        node = (u32)nodes.size();
+
+        ProfileNode child;
+        child.name = name;
+        child.parent = thread->current;
+        child.nextSibling = nodes[thread->current].firstChild;
+        nodes.push_back(child);
+
+        nodes[thread->current].firstChild = node;
+    }
+
+    thread->current = node;
+    nodes[node].start = Profiler::ticks();
+}
+
+void Profiler::end() noexcept
+{
+    u64 now = Profiler::ticks();
+
+    ProfileThread *thread = _GetProfileThread();
+    ProfileNode &node = thread->nodes[thread->current];
+    assert(node.parent != ProfileNode::NONE);
+
+    node.ticks += now - node.start;
+    node.calls += 1;
+
+    thread->current = node.parent;
+}
+
+/**
+ * Merge the children of a thread's node into the children of a report node.
+ */
+static void _Merge(const ProfileThread *thread, u32 node, ProfileReportNode &out_node)
+{
+    // The children are linked in reverse order of their first entrance.
+    std::vector<u32> children;
+    for (u32 child = thread->nodes[node].firstChild; child != ProfileNode::NONE; child = thread->nodes[child].nextSibling)
+    {
+        children.insert(children.begin(), child);
+    }
+
+    for (u32 child : children)
+    {
+        const ProfileNode &source = thread->nodes[child];
+
+        ProfileReportNode *target = nullptr;
+        for (ProfileReportNode &existing : out_node.children)
+        {
+            if (strcmp(existing.name, source.name) == 0)
+            {
+                target = &existing;
+                break;
+            }
+        }
+        if (target == nullptr)
+        {
+            out_node.children.push_back(ProfileReportNode());
+            target = &out_node.children.back();
+            target->name = source.name;
+        }
+
+        target->ticks += source.ticks;
+        target->calls += source.calls;
+        target->threads += 1;
+
+        _Merge(thread, child, *target);
+    }
+}
+
+static void _Print(const ProfileReportNode &node, u64 parentTicks, f64 secondsPerTick, u32 depth)
+{
+    for (const ProfileReportNode &child : node.children)
+    {
+        std::ostringstream line;
+        line << std::string(depth * 2, ' ') << std::left << std::setw(32 - depth * 2) << child.name
+            << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << (f64)child.ticks * secondsPerTick * 1000.0 << " ms"
+            << std::setw(10) << child.calls << " calls";
+        if (parentTicks > 0)
+        {
+            line << std::setprecision(1) << std::setw(8) << 100.0 * (f64)child.ticks / (f64)parentTicks << "%";
+        }
+        if (child.threads > 1)
+        {
+            line << "  on " << child.threads << " threads";
+        }
+
+        LOG(INFO) << line.str();
+
+        _Print(child, child.ticks, secondsPerTick, depth + 1);
+    }
+}
+
+void Profiler::report() noexcept
+{
+    f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - _startTime).count();
+    u64 ticks = Profiler::ticks() - _startTicks;
+    f64 secondsPerTick = ticks > 0 ? seconds / (f64)ticks : 0.0;
+
+    ProfileReportNode root;
+    root.name = "";
+    {
+        std::lock_guard<std::mutex> lock(_profileMutex);
+        for (const ProfileThread *thread : _profileThreads)
+        {
+            _Merge(thread, 0, root);
+        }
+    }
+
+    if (root.children.empty())
+    {
+        return;
+    }
+
+    LOG(INFO) << "Profile of " << seconds << " s:";
+    _Print(root, 0, secondsPerTick, 0);
+}
+
+CS6620_NAMESPACE_END
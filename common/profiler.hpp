@@ -0,0 +1,105 @@
+/**
+ * \file profiler.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The wall clock timer and the hierarchical scope profiler.
+ */
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "common.h"
+
+#include <chrono>
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * Measure the wall clock time with the steady clock. Unlike cy::Timer,
+ * which is based on clock(), it's not affected by how many threads run
+ * meanwhile.
+ */
+class Timer
+{
+public:
+    /**
+     * Constructor. The timer starts right away.
+     */
+    explicit Timer() { this->start(); }
+    /**
+     * Restart the timer.
+     */
+    void start() { this->_start = std::chrono::steady_clock::now(); }
+    /**
+     * The seconds passed since the start.
+     */
+    f64 elapsed() const { return std::chrono::duration<f64>(std::chrono::steady_clock::now() - this->_start).count(); }
+
+private:
+    std::chrono::steady_clock::time_point _start;
+};
+
+/**
+ * The profiler accumulates the time spent in the named scopes of every
+ * thread. Each thread keeps its own tree of scopes, so the hot path never
+ * locks, and the trees of all threads are merged by the scope names into a
+ * hierarchical report when the program exits.
+ *
+ * The scopes are timed by the time stamp counter on x86 and by the steady
+ * clock elsewhere. The counter is converted to seconds against the steady
+ * clock over the whole run, which assumes an invariant TSC as all recent
+ * x86 CPUs have.
+ *
+ * The scope names must be string literals or otherwise outlive the report.
+ */
+class Profiler
+{
+public:
+    /**
+     * Enter a scope nested in the current one of the calling thread.
+     */
+    static void begin(const char *name) noexcept;
+    /**
+     * Leave the current scope of the calling thread.
+     */
+    static void end() noexcept;
+    /**
+     * Log the merged scopes of all threads. It's called at exit but can be
+     * called earlier when no other thread is in a scope.
+     */
+    static void report() noexcept;
+    /**
+     * The current value of the clock the scopes are timed by.
+     */
+    static u64 ticks() noexcept;
+};
+
+/**
+ * Time the enclosing block as a profiler scope.
+ */
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char *name) { Profiler::begin(name); }
+
+    ~ProfileScope() { Profiler::end(); }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+CS6620_NAMESPACE_END
+
+// Define CS6620_NO_PROFILE to compile the scopes out.
+#if defined(CS6620_NO_PROFILE)
+#define CS6620_PROFILE_SCOPE(name)
+#else
+#define CS6620_PROFILE_CONCAT_(a, b) a##b
+#define CS6620_PROFILE_CONCAT(a, b) CS6620_PROFILE_CONCAT_(a, b)
+#define CS6620_PROFILE_SCOPE(name) cs6620::ProfileScope CS6620_PROFILE_CONCAT(_profileScope, __LINE__)(name)
+#endif
+
+
+#endif // !PROFILER_HPP
@@ -16,6 +16,11 @@
 
 CS6620_NAMESPACE_BEGIN
 
+/**
+ * The minimum hit distance along a ray, which avoids self intersection.
+ */
+const f32 RAY_EPSILON = 1e-4f;
+
 class Ray
 {
 public:
@@ -0,0 +1,306 @@
+/**
+ * \file renderer.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * Render the scene into the view with multiple threads.
+ */
+
+#include "renderer.hpp"
+
+#include "scene.hpp"
+#include "camera.hpp"
+#include "view.hpp"
+#include "sampler.hpp"
+#include "thread_pool.hpp"
+#include "profiler.hpp"
+#include "stats.hpp"
+
+
+CS6620_NAMESPACE_BEGIN
+
+Renderer::Renderer(const Scene *scene, View *view, const Sampler *sampler, ThreadPool *pool, u32 tileSize)
+{
+    assert(pool != nullptr && tileSize > 0);
+
+    this->_scene = scene;
+    this->_view = view;
+    this->_sampler = sampler;
+    this->_pool = pool;
+    this->_tileSize = tileSize;
+
+    // Let the view convert the image on the same threads when dumped.
+    this->_view->setThreadPool(this->_pool);
+
+    // Cut the image into tiles in scanline order.
+    u32 width = scene->camera->width;
+    u32 height = scene->camera->height;
+    for (u32 y = 0; y < height; y += tileSize)
+    for (u32 x = 0; x < width; x += tileSize)
+    {
+        Tile tile;
+        tile.x0 = x;
+        tile.y0 = y;
+        tile.x1 = cy::Min(x + tileSize, width);
+        tile.y1 = cy::Min(y + tileSize, height);
+        this->_tiles.push_back(tile);
+    }
+}
+
+Renderer::~Renderer()
+{
+    this->_view->setThreadPool(nullptr);
+}
+
+u32 Renderer::numThreads() const
+{
+    return this->_pool->size();
+}
+
+void Renderer::render() noexcept
+{
+    CS6620_PROFILE_SCOPE("Render");
+
+    this->_pool->run((u32)this->_tiles.size(), [this](u32 task, u32)
+    {
+        this->_renderTile(this->_tiles[task]);
+    });
+}
+
+void Renderer::renderPass(u32 pass) noexcept
+{
+    CS6620_PROFILE_SCOPE("Render pass");
+
+    this->_pool->run((u32)this->_tiles.size(), [this, pass](u32 task, u32)
+    {
+        this->_renderTilePass(this->_tiles[task], pass);
+    });
+}
+
+bool Renderer::renderProgressive(u32 numPasses, u32 dumpPasses, f32 dumpSeconds, const char *outputFilePath) noexcept
+{
+    if (numPasses == 0)
+    {
+        numPasses = this->_sampler->count();
+    }
+
+    CS6620_PROFILE_SCOPE("Render progressive");
+
+    this->_view->clear();
+
+    Timer timer;
+    f64 lastDump = 0.0;
+
+    for (u32 pass = 0; pass < numPasses; ++pass)
+    {
+        this->renderPass(pass);
+
+        // Skip the last pass as the caller dumps the final image anyway.
+        if (pass + 1 == numPasses)
+        {
+            break;
+        }
+
+        f64 now = timer.elapsed();
+        bool dumpByPasses = dumpPasses > 0 && (pass + 1) % dumpPasses == 0;
+        bool dumpBySeconds = dumpSeconds > 0.0f && now - lastDump >= dumpSeconds;
+        if (dumpByPasses || dumpBySeconds)
+        {
+            // The next pass goes on while the preview is written.
+            this->_view->dumpAsync(outputFilePath);
+            lastDump = now;
+
+            LOG(INFO) << "Pass " << pass + 1 << "/" << numPasses << " dumped after "
+                << now << " s.";
+        }
+    }
+
+    return this->_view->flush();
+}
+
+u64 Renderer::renderAdaptive(u32 minSamples, f32 threshold) noexcept
+{
+    u32 maxSamples = this->_sampler->count();
+    minSamples = cy::Clamp(minSamples, 2u, maxSamples);
+
+    CS6620_PROFILE_SCOPE("Render adaptive");
+
+    this->_view->clear();
+
+    u64 totalSamples = 0;
+    std::vector<u32> tileSamples(this->_tiles.size());
+
+    for (u32 pass = 0; pass < maxSamples; ++pass)
+    {
+        this->_pool->run((u32)this->_tiles.size(), [&](u32 task, u32)
+        {
+            tileSamples[task] = this->_renderTileAdaptive(this->_tiles[task], pass, minSamples, threshold);
+        });
+
+        u64 passSamples = 0;
+        for (u32 n : tileSamples)
+        {
+            passSamples += n;
+        }
+        if (passSamples == 0)
+        {
+            break;
+        }
+        totalSamples += passSamples;
+    }
+
+    return totalSamples;
+}
+
+bool Renderer::renderStreaming(const char *outputFilePath) noexcept
+{
+    CS6620_PROFILE_SCOPE("Render streaming");
+
+    if (!this->_view->beginStream(outputFilePath))
+    {
+        return false;
+    }
+
+    u32 width = this->_view->width();
+    u32 height = this->_view->height();
+    u32 windowHeight = this->_view->windowHeight();
+
+    std::vector<Tile> tiles;
+    for (u32 windowY = 0; windowY < height; windowY += windowHeight)
+    {
+        this->_view->moveWindow(windowY);
+
+        // Cut the window into tiles of its own, as it needn't line up with
+        // the tiles of the whole image.
+        u32 windowY1 = cy::Min(windowY + windowHeight, height);
+        tiles.clear();
+        for (u32 y = windowY; y < windowY1; y += this->_tileSize)
+        for (u32 x = 0; x < width; x += this->_tileSize)
+        {
+            Tile tile;
+            tile.x0 = x;
+            tile.y0 = y;
+            tile.x1 = cy::Min(x + this->_tileSize, width);
+            tile.y1 = cy::Min(y + this->_tileSize, windowY1);
+            tiles.push_back(tile);
+        }
+
+        this->_pool->run((u32)tiles.size(), [this, &tiles](u32 task, u32)
+        {
+            this->_renderTile(tiles[task]);
+        });
+
+        // The window is written in the background while the next one renders.
+        this->_view->streamWindow();
+    }
+
+    return this->_view->endStream();
+}
+
+void Renderer::_renderTile(const Tile &tile) const noexcept
+{
+    CS6620_PROFILE_SCOPE("Render tile");
+
+    const Camera *camera = this->_scene->camera;
+
+    u32 N = this->_sampler->count();
+
+    // The sub-pixel positions are generated in batches on the stack.
+    const u32 BATCH_SIZE = 64;
+    f32 xs[BATCH_SIZE];
+    f32 ys[BATCH_SIZE];
+
+    for (u32 i = tile.y0; i < tile.y1; ++i)
+    for (u32 j = tile.x0; j < tile.x1; ++j)
+    {
+        vec3 color = vec3(0, 0, 0);
+        for (u32 first = 0; first < N; first += BATCH_SIZE)
+        {
+            u32 count = cy::Min(N - first, BATCH_SIZE);
+            this->_sampler->generate(vec2u(j, i), first, count, 0, xs);
+            this->_sampler->generate(vec2u(j, i), first, count, 1, ys);
+
+            // The camera rays are made a packet at a time and shaded in
+            // the same order as one by one.
+            u32 s = 0;
+            RayPacket<PACKET_WIDTH> rays;
+            for (; s + PACKET_WIDTH <= count; s += PACKET_WIDTH)
+            {
+                f32xN x = f32xN((f32)j) + f32xN::load(xs + s);
+                f32xN y = f32xN((f32)i) + f32xN::load(ys + s);
+
+                camera->unproject(x, y, rays);
+
+                for (int lane = 0; lane < PACKET_WIDTH; ++lane)
+                {
+                    color += this->_scene->shade(rays.get(lane));
+                }
+            }
+            for (; s < count; ++s)
+            {
+                f32 x = (f32)j + xs[s];
+                f32 y = (f32)i + ys[s];
+
+                Ray ray = camera->unproject(x, y);
+
+                color += this->_scene->shade(ray);
+            }
+        }
+
+        this->_view->write(vec2u(j, i), color / (f32)N);
+    }
+
+    CS6620_STATS_ADD(PRIMARY_RAYS, (tile.x1 - tile.x0) * (tile.y1 - tile.y0) * N);
+}
+
+void Renderer::_renderTilePass(const Tile &tile, u32 pass) const noexcept
+{
+    CS6620_PROFILE_SCOPE("Render tile");
+
+    const Camera *camera = this->_scene->camera;
+
+    for (u32 i = tile.y0; i < tile.y1; ++i)
+    for (u32 j = tile.x0; j < tile.x1; ++j)
+    {
+        vec2 sample = this->_sampler->sample(vec2u(j, i), pass);
+
+        Ray ray = camera->unproject((f32)j + sample.x, (f32)i + sample.y);
+
+        this->_view->accumulate(vec2u(j, i), this->_scene->shade(ray));
+    }
+
+    CS6620_STATS_ADD(PRIMARY_RAYS, (tile.x1 - tile.x0) * (tile.y1 - tile.y0));
+}
+
+u32 Renderer::_renderTileAdaptive(const Tile &tile, u32 pass, u32 minSamples, f32 threshold) const noexcept
+{
+    CS6620_PROFILE_SCOPE("Render tile");
+
+    const Camera *camera = this->_scene->camera;
+
+    u32 numSamples = 0;
+
+    for (u32 i = tile.y0; i < tile.y1; ++i)
+    for (u32 j = tile.x0; j < tile.x1; ++j)
+    {
+        vec2u coordinate(j, i);
+        if (pass >= minSamples && this->_view->error(coordinate) <= threshold)
+        {
+            continue;
+        }
+
+        vec2 sample = this->_sampler->sample(coordinate, pass);
+
+        Ray ray = camera->unproject((f32)j + sample.x, (f32)i + sample.y);
+
+        this->_view->accumulate(coordinate, this->_scene->shade(ray));
+        ++numSamples;
+    }
+
+    CS6620_STATS_ADD(PRIMARY_RAYS, numSamples);
+
+    return numSamples;
+}
+
+CS6620_NAMESPACE_END
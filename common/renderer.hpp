@@ -0,0 +1,122 @@
+/**
+ * \file renderer.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * Render the scene into the view with multiple threads.
+ */
+
+#ifndef RENDERER_HPP
+#define RENDERER_HPP
+
+#include "common.h"
+
+#include <vector>
+
+CS6620_NAMESPACE_BEGIN
+
+class Scene;
+class View;
+class Sampler;
+class ThreadPool;
+
+/**
+ * The renderer splits the view into square tiles and shades them on a pool
+ * of worker threads. Every pixel is computed in the same way no matter which
+ * thread renders it, so the result doesn't depend on the thread count.
+ */
+class Renderer
+{
+public:
+    /**
+     * Constructor.
+     * @param scene the prepared scene.
+     * @param view the target of the rendering.
+     * @param sampler the sub-pixel sample positions.
+     * @param pool the worker threads, e.g., the ones the scene was prepared
+     * with. It must outlive the renderer.
+     * @param tileSize the width and height of a tile in pixels.
+     */
+    explicit Renderer(const Scene *scene, View *view, const Sampler *sampler, ThreadPool *pool, u32 tileSize = 32);
+    /**
+     * Destructor.
+     */
+    ~Renderer();
+    /**
+     * Render the whole view and return when all tiles are done.
+     */
+    void render() noexcept;
+    /**
+     * Render one sample per pixel and add it to the accumulation of the view.
+     * The pass takes the sampler's samples in turn, so after as many passes
+     * as the sampler has samples the view converges to what render() gives.
+     * @param pass the index of the pass since the view is cleared.
+     */
+    void renderPass(u32 pass) noexcept;
+    /**
+     * Render progressively and dump the intermediate images along the way.
+     * They are written in the background while the next passes render.
+     * @param numPasses the number of passes. 0 means the sampler's sample count.
+     * @param dumpPasses dump after every that many passes. 0 disables it.
+     * @param dumpSeconds dump when that many seconds passed since the last dump. 0 disables it.
+     * @param outputFilePath where to dump the images.
+     * @return false if a dump fails.
+     */
+    bool renderProgressive(u32 numPasses, u32 dumpPasses, f32 dumpSeconds, const char *outputFilePath) noexcept;
+    /**
+     * Render with as many samples per pixel as it needs. Every pixel takes
+     * at least minSamples, then keeps sampling until the standard error of
+     * its luminance drops below the threshold or it runs out of the
+     * sampler's samples.
+     * @param minSamples the number of samples before the error is checked, at least 2.
+     * @param threshold the standard error at which a pixel stops.
+     * @return the total number of samples taken.
+     */
+    u64 renderAdaptive(u32 minSamples, f32 threshold) noexcept;
+    /**
+     * Render the view a window of rows at a time and stream each window to
+     * a .ppm file once it's done, while the next one renders. Only the
+     * window and the bands waiting to be written are held in memory.
+     * @param outputFilePath where to write the image.
+     * @return false if the file can't be written.
+     */
+    bool renderStreaming(const char *outputFilePath) noexcept;
+    /**
+     * The number of worker threads.
+     */
+    u32 numThreads() const;
+
+private:
+    struct Tile
+    {
+        u32 x0, y0; /**< The top left corner. */
+        u32 x1, y1; /**< The bottom right corner, exclusive. */
+    };
+    /**
+     * Shade all pixels of a tile.
+     */
+    void _renderTile(const Tile &tile) const noexcept;
+    /**
+     * Shade one sample of every pixel of a tile and accumulate them.
+     */
+    void _renderTilePass(const Tile &tile, u32 pass) const noexcept;
+    /**
+     * Shade one more sample of the pixels of a tile that haven't converged.
+     * @return the number of the shaded samples.
+     */
+    u32 _renderTileAdaptive(const Tile &tile, u32 pass, u32 minSamples, f32 threshold) const noexcept;
+
+private:
+    const Scene   *_scene;
+    View          *_view;
+    const Sampler *_sampler;
+    ThreadPool    *_pool;    /**< Not owned. */
+    u32            _tileSize;
+    std::vector<Tile> _tiles;
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !RENDERER_HPP
@@ -9,18 +9,122 @@
 
 #include "sampler.hpp"
 
+#if defined(CS6620_AVX2)
+#include <immintrin.h>
+#endif
+
 
 CS6620_NAMESPACE_BEGIN
-    
+
+/**
+ * The largest float below 1.
+ */
+static const f32 ONE_MINUS_EPSILON = 0.99999994f;
+
+/**
+ * Mix the bits of an integer (lowbias32 of Chris Wellons).
+ */
+static inline u32 _Hash(u32 x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline u32 _Hash(u32 a, u32 b)
+{
+    return _Hash(a ^ _Hash(b + 0x9e3779b9u));
+}
+
+static inline u32 _ReverseBits(u32 x)
+{
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+/**
+ * The hash based Owen scrambling of Laine and Karras 2011 with the constants
+ * of Burley 2020. Flipping a bit only depends on the bits above it, which
+ * is what makes it a nested uniform scrambling.
+ */
+static inline u32 _OwenScramble(u32 x, u32 seed)
+{
+    x = _ReverseBits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return _ReverseBits(x);
+}
+
+static inline f32 _ToFloat(u32 x)
+{
+    // Keep the top 24 bits so the result is exact and below 1.
+    return (f32)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+//
+// class Sampler
+//
 Sampler::Sampler(u32 n)
 {
+    assert(n > 0);
+
     this->_samples.resize(n);
+
+    // Take the samples in bit reversed order. It's only a permutation if
+    // the count is a power of two.
+    u32 bits = 0;
+    while ((1u << bits) < n)
+    {
+        ++bits;
+    }
+    this->_order.resize(n);
+    for (u32 i = 0; i < n; ++i)
+    {
+        u32 reversed = bits > 0 ? _ReverseBits(i) >> (32 - bits) : 0;
+        this->_order[i] = (1u << bits) == n ? reversed : i;
+    }
 }
 
 Sampler::~Sampler()
 {
 }
-    
+
+f32 Sampler::get(const vec2u &, u32 index, u32 dimension) const noexcept
+{
+    const vec2 &sample = this->_samples[this->_order[index % this->count()]];
+
+    switch (dimension)
+    {
+    case 0:
+        return sample.x;
+    case 1:
+        return sample.y;
+    default:
+        return 0.5f;
+    }
+}
+
+void Sampler::generate(const vec2u &pixel, u32 first, u32 count, u32 dimension, f32 *out) const noexcept
+{
+    for (u32 i = 0; i < count; ++i)
+    {
+        out[i] = this->get(pixel, first + i, dimension);
+    }
+}
+
+//
+// class NaiveSampler
+//
 NaiveSampler::NaiveSampler(u32 n)
     : Sampler(n)
 {
@@ -49,5 +153,223 @@ NaiveSampler::NaiveSampler(u32 n)
 NaiveSampler::~NaiveSampler()
 {
 }
-    
-CS6620_NAMESPACE_END
\ No newline at end of file
+
+//
+// class SobolSampler
+//
+
+/**
+ * The direction numbers of the Sobol sequence. The first dimension is the
+ * van der Corput sequence and the others are from the table of Joe and Kuo
+ * 2008.
+ */
+struct SobolDirections
+{
+    u32 v[SobolSampler::NUM_DIMENSIONS][32];
+
+    SobolDirections()
+    {
+        // The degree, the coefficients and the initial direction numbers
+        // of the primitive polynomials.
+        static const u32 degrees[] = { 1, 2, 3, 3, 4, 4, 5 };
+        static const u32 coefficients[] = { 0, 1, 1, 2, 1, 4, 2 };
+        static const u32 initials[][5] = {
+            { 1 },
+            { 1, 3 },
+            { 1, 3, 1 },
+            { 1, 1, 1 },
+            { 1, 1, 3, 3 },
+            { 1, 3, 5, 13 },
+            { 1, 1, 5, 5, 17 },
+        };
+
+        for (u32 k = 0; k < 32; ++k)
+        {
+            this->v[0][k] = 1u << (31 - k);
+        }
+
+        for (u32 d = 1; d < SobolSampler::NUM_DIMENSIONS; ++d)
+        {
+            u32 s = degrees[d - 1];
+            u32 a = coefficients[d - 1];
+            u32 *v = this->v[d];
+
+            for (u32 k = 0; k < s; ++k)
+            {
+                v[k] = initials[d - 1][k] << (31 - k);
+            }
+            for (u32 k = s; k < 32; ++k)
+            {
+                v[k] = v[k - s] ^ (v[k - s] >> s);
+                for (u32 j = 1; j < s; ++j)
+                {
+                    if ((a >> (s - 1 - j)) & 1)
+                    {
+                        v[k] ^= v[k - j];
+                    }
+                }
+            }
+        }
+    }
+};
+
+static const SobolDirections SOBOL;
+
+SobolSampler::SobolSampler(u32 n, u32 seed)
+    : Sampler(n)
+{
+    this->_seed = seed;
+
+    for (u32 i = 0; i < n; ++i)
+    {
+        this->_samples[i] = this->sample(vec2u(0, 0), i);
+    }
+}
+
+SobolSampler::~SobolSampler()
+{
+}
+
+f32 SobolSampler::get(const vec2u &pixel, u32 index, u32 dimension) const noexcept
+{
+    u32 seed = _Hash(_Hash(pixel.x, pixel.y), this->_seed);
+
+    // Shuffle the samples of the pixel.
+    u32 i = _OwenScramble(index, seed);
+
+    const u32 *v = SOBOL.v[dimension % NUM_DIMENSIONS];
+    u32 x = 0;
+    for (u32 k = 0; i != 0; i >>= 1, ++k)
+    {
+        if (i & 1)
+        {
+            x ^= v[k];
+        }
+    }
+
+    return _ToFloat(_OwenScramble(x, _Hash(seed, dimension)));
+}
+
+#if defined(CS6620_AVX2)
+static inline __m256i _ReverseBits(__m256i x)
+{
+    const __m256i m8 = _mm256_set1_epi32(0x00ff00ff);
+    const __m256i m4 = _mm256_set1_epi32(0x0f0f0f0f);
+    const __m256i m2 = _mm256_set1_epi32(0x33333333);
+    const __m256i m1 = _mm256_set1_epi32(0x55555555);
+
+    x = _mm256_or_si256(_mm256_slli_epi32(x, 16), _mm256_srli_epi32(x, 16));
+    x = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(x, m8), 8), _mm256_and_si256(_mm256_srli_epi32(x, 8), m8));
+    x = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(x, m4), 4), _mm256_and_si256(_mm256_srli_epi32(x, 4), m4));
+    x = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(x, m2), 2), _mm256_and_si256(_mm256_srli_epi32(x, 2), m2));
+    x = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(x, m1), 1), _mm256_and_si256(_mm256_srli_epi32(x, 1), m1));
+    return x;
+}
+
+static inline __m256i _OwenScramble(__m256i x, u32 seed)
+{
+    x = _ReverseBits(x);
+    x = _mm256_add_epi32(x, _mm256_set1_epi32((i32)seed));
+    x = _mm256_xor_si256(x, _mm256_mullo_epi32(x, _mm256_set1_epi32((i32)0x6c50b47cu)));
+    x = _mm256_xor_si256(x, _mm256_mullo_epi32(x, _mm256_set1_epi32((i32)0xb82f1e52u)));
+    x = _mm256_xor_si256(x, _mm256_mullo_epi32(x, _mm256_set1_epi32((i32)0xc7afe638u)));
+    x = _mm256_xor_si256(x, _mm256_mullo_epi32(x, _mm256_set1_epi32((i32)0x8d22f6e6u)));
+    return _ReverseBits(x);
+}
+#endif
+
+void SobolSampler::generate(const vec2u &pixel, u32 first, u32 count, u32 dimension, f32 *out) const noexcept
+{
+    u32 seed = _Hash(_Hash(pixel.x, pixel.y), this->_seed);
+    u32 dimensionSeed = _Hash(seed, dimension);
+    const u32 *v = SOBOL.v[dimension % NUM_DIMENSIONS];
+
+    u32 i = 0;
+
+#if defined(CS6620_AVX2)
+    // 8 samples at a time, going through all bits of the shuffled indices.
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256 scale = _mm256_set1_ps(1.0f / 16777216.0f);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i index = _mm256_add_epi32(_mm256_set1_epi32((i32)(first + i)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        index = _OwenScramble(index, seed);
+
+        __m256i x = _mm256_setzero_si256();
+        for (u32 k = 0; k < 32; ++k)
+        {
+            __m256i bit = _mm256_and_si256(_mm256_srli_epi32(index, (i32)k), one);
+            __m256i mask = _mm256_sub_epi32(_mm256_setzero_si256(), bit);
+            x = _mm256_xor_si256(x, _mm256_and_si256(mask, _mm256_set1_epi32((i32)v[k])));
+        }
+
+        x = _OwenScramble(x, dimensionSeed);
+        _mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(x, 8)), scale));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        u32 index = _OwenScramble(first + i, seed);
+
+        u32 x = 0;
+        for (u32 k = 0; index != 0; index >>= 1, ++k)
+        {
+            if (index & 1)
+            {
+                x ^= v[k];
+            }
+        }
+
+        out[i] = _ToFloat(_OwenScramble(x, dimensionSeed));
+    }
+}
+
+//
+// class HaltonSampler
+//
+static const u32 PRIMES[HaltonSampler::NUM_DIMENSIONS] = {
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+};
+
+HaltonSampler::HaltonSampler(u32 n, u32 seed)
+    : Sampler(n)
+{
+    this->_seed = seed;
+
+    for (u32 i = 0; i < n; ++i)
+    {
+        this->_samples[i] = this->sample(vec2u(0, 0), i);
+    }
+}
+
+HaltonSampler::~HaltonSampler()
+{
+}
+
+f32 HaltonSampler::get(const vec2u &pixel, u32 index, u32 dimension) const noexcept
+{
+    u32 base = PRIMES[dimension % NUM_DIMENSIONS];
+    u32 seed = _Hash(_Hash(_Hash(pixel.x, pixel.y), this->_seed), dimension);
+
+    // Go through the digits until they no longer change a float, past the
+    // last nonzero one of the index as the zeros are scrambled as well.
+    f32 invBase = 1.0f / (f32)base;
+    f32 weight = invBase;
+    f32 x = 0.0f;
+    for (u32 digit = 0; weight > 1.0f / 16777216.0f; ++digit)
+    {
+        u32 d = index % base;
+        index /= base;
+
+        d = (d + _Hash(seed, digit) % base) % base;
+
+        x += (f32)d * weight;
+        weight *= invBase;
+    }
+
+    return cy::Min(x, ONE_MINUS_EPSILON);
+}
+
+CS6620_NAMESPACE_END
@@ -16,6 +16,12 @@
 
 CS6620_NAMESPACE_BEGIN
 
+/**
+ * The sampler gives the sample values in [0, 1) of every pixel. A sample
+ * has as many dimensions as the renderer asks for, the first two of which
+ * are the sub-pixel position. A sampler is used by all render threads at
+ * once, so generating a sample must not change it.
+ */
 class Sampler
 {
 public:
@@ -28,8 +34,33 @@ public:
 
     vec2 * samples() { return &this->_samples[0]; }; 
 
+    const vec2 * samples() const { return &this->_samples[0]; }
+    /**
+     * The number of samples per pixel.
+     */
+    u32 count() const { return (u32)this->_samples.size(); }
+    /**
+     * One dimension of a sample of a pixel. By default the dimensions 0 and
+     * 1 are taken from samples() in bit reversed order, so that any first
+     * few of them spread over the whole pixel, and the others are 0.5.
+     * @param pixel the pixel coordinate.
+     * @param index the index of the sample in the pixel.
+     * @param dimension the dimension of the sample.
+     */
+    virtual f32 get(const vec2u &pixel, u32 index, u32 dimension) const noexcept;
+    /**
+     * One dimension of the samples [first, first + count) of a pixel.
+     * @param out the count values.
+     */
+    virtual void generate(const vec2u &pixel, u32 first, u32 count, u32 dimension, f32 *out) const noexcept;
+    /**
+     * The sub-pixel position of a sample of a pixel.
+     */
+    vec2 sample(const vec2u &pixel, u32 index) const { return vec2(this->get(pixel, index, 0), this->get(pixel, index, 1)); }
+
 protected:
     std::vector<vec2> _samples;
+    std::vector<u32>  _order;   /**< The order get() takes samples(). */
 };
 
 class NaiveSampler : public Sampler
@@ -43,6 +74,60 @@ public:
     virtual ~NaiveSampler();
 };
 
+/**
+ * The Sobol sequence with Owen scrambling. Each pixel and dimension gets
+ * its own scrambling, and the sample indices are shuffled per pixel in the
+ * same way, so the pixels don't share patterns while every power of two
+ * prefix of a pixel's samples stays well stratified. The dimensions beyond
+ * the tabulated ones reuse them with independent scrambling.
+ */
+class SobolSampler : public Sampler
+{
+public:
+    static const u32 NUM_DIMENSIONS = 8; /**< The number of tabulated dimensions. */
+
+public:
+    /**
+     * @param n the number of samples per pixel, not limited to powers of two.
+     * @param seed the seed of the scrambling.
+     */
+    explicit SobolSampler(u32 n, u32 seed = 0);
+
+    virtual ~SobolSampler();
+
+    virtual f32 get(const vec2u &pixel, u32 index, u32 dimension) const noexcept override;
+
+    virtual void generate(const vec2u &pixel, u32 first, u32 count, u32 dimension, f32 *out) const noexcept override;
+
+private:
+    u32 _seed;
+};
+
+/**
+ * The Halton sequence with random digit scrambling. The digits of the
+ * radical inverse are shifted by random amounts that depend on the pixel,
+ * the dimension and the digit position.
+ */
+class HaltonSampler : public Sampler
+{
+public:
+    static const u32 NUM_DIMENSIONS = 16; /**< The number of prime bases. */
+
+public:
+    /**
+     * @param n the number of samples per pixel.
+     * @param seed the seed of the scrambling.
+     */
+    explicit HaltonSampler(u32 n, u32 seed = 0);
+
+    virtual ~HaltonSampler();
+
+    virtual f32 get(const vec2u &pixel, u32 index, u32 dimension) const noexcept override;
+
+private:
+    u32 _seed;
+};
+
 CS6620_NAMESPACE_END
 
 #endif // !SAMPLER_HPP
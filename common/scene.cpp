@@ -11,9 +11,14 @@
 
 #include "scene_node.hpp"
 #include "camera.hpp"
-#include "tree.hpp"
+#include "bvh_tree.hpp"
+#include "snapshot.hpp"
+
+#include "profiler.hpp"
+#include "stats.hpp"
 
 #include <list>
+#include <memory>
 
 CS6620_NAMESPACE_BEGIN
 
@@ -28,6 +33,8 @@ Scene::~Scene()
 
 bool Scene::load(const char *sceneFile) noexcept
 {
+    CS6620_PROFILE_SCOPE("Scene load");
+
     // The scene has data already. Clear it first.
     if (this->root != nullptr)
     {
@@ -36,6 +43,11 @@ bool Scene::load(const char *sceneFile) noexcept
         this->_destroy();
     }
 
+    if (SceneSnapshot::test(sceneFile))
+    {
+        return SceneSnapshot::load(this, sceneFile);
+    }
+
     LOG(INFO) << "Start parsing XML '" << sceneFile << "'";
     
     tinyxml2::XMLDocument xmlDoc;
@@ -61,14 +73,14 @@ bool Scene::load(const char *sceneFile) noexcept
 
     assert(this->root == nullptr);
 
-    this->root = new SceneNode("root", nullptr);
+    this->root = this->_arena.create<SceneNode>(&this->_arena, "root", nullptr);
 
     tinyxml2::XMLElement *nodeElement = sceneElement->FirstChildElement();
     while (nodeElement != nullptr)
     {
         if (strncmp(nodeElement->Name(), "object", 6) == 0)
         {
-            SceneNode *node = SceneNodeFactory::unserialize(nodeElement, this->root);
+            SceneNode *node = SceneNodeFactory::unserialize(&this->_arena, nodeElement, this->root);
             if (node == nullptr)
             {
                 LOG(ERROR) << "Fail to unserialize " << nodeElement->Name();
@@ -108,16 +120,34 @@ bool Scene::load(const char *sceneFile) noexcept
     return true;
 }
 
-void Scene::prepare() noexcept
+bool Scene::save(const char *snapshotFile) const noexcept
 {
-    this->_tree = new Tree(this);
+    if (this->root == nullptr || this->camera == nullptr)
+    {
+        LOG(ERROR) << "The scene is empty.";
+        return false;
+    }
+
+    return SceneSnapshot::write(this, snapshotFile);
 }
 
-void Scene::_destroy()
+void Scene::prepare(const char *bvhCacheDirectory, u32 bvhWidth, BVHBuilder bvhBuilder, ThreadPool *pool) noexcept
 {
-    // Delete the scene nodes using BFS.
-    std::list<SceneNode *> nodes;
-    nodes.push_back(this->root);
+    CS6620_PROFILE_SCOPE("Scene prepare");
+
+    delete this->_tree;
+
+    Timer timer;
+
+    std::unique_ptr<BVHCache> cache;
+    if (bvhCacheDirectory != nullptr)
+    {
+        cache.reset(new BVHCache(bvhCacheDirectory));
+    }
+
+    // Let the nodes build their own structures first, as the tree needs
+    // their final bounds.
+    std::list<SceneNode *> nodes(this->root->children.begin(), this->root->children.end());
     while (!nodes.empty())
     {
         SceneNode *node = nodes.front();
@@ -125,13 +155,59 @@ void Scene::_destroy()
 
         nodes.insert(nodes.end(), node->children.begin(), node->children.end());
 
-        delete node;
+        if (node->type == SceneNode::Type::GEOMETRY)
+        {
+            static_cast<GeometricNode *>(node)->prepare(cache.get(), pool);
+        }
+    }
+
+    BVHTree *tree = new BVHTree(this, this->_cachedBVH, cache.get(), bvhWidth, bvhBuilder, pool);
+
+    f64 seconds = timer.elapsed();
+
+    LOG(INFO) << "BVH ready with " << tree->bvh().numNodes() << " nodes, depth " << tree->bvh().depth()
+        << " in " << seconds * 1000.0 << " ms.";
+    if (tree->width() > 2)
+    {
+        LOG(INFO) << "Traversing it as a BVH" << tree->width() << " with " << tree->numTraversedNodes() << " nodes.";
     }
 
+    this->_tree = tree;
+}
+
+bool Scene::update(f32 rebuildThreshold, ThreadPool *pool) noexcept
+{
+    CS6620_PROFILE_SCOPE("Scene update");
+
+    if (this->_tree == nullptr)
+    {
+        LOG(ERROR) << "The scene isn't prepared.";
+        return false;
+    }
+
+    Timer timer;
+
+    bool rebuilt = this->_tree->update(rebuildThreshold, pool);
+
+    LOG(INFO) << "BVH " << (rebuilt ? "rebuilt" : "refit") << " in " << timer.elapsed() * 1000.0 << " ms.";
+
+    return rebuilt;
+}
+
+void Scene::_destroy()
+{
+    delete this->_tree;
+    this->_tree = nullptr;
+
+    delete this->_cachedBVH;
+    this->_cachedBVH = nullptr;
+
+    // The nodes go away with the arena at once.
+    this->_arena.release();
     this->root = nullptr;
 }
 
-vec3 Scene::shade(const Ray &ray)
+vec3 Scene::shade(const Ray &ray) const
 {
     vec3 result;
 
@@ -140,6 +216,8 @@ vec3 Scene::shade(const Ray &ray)
     vec3 normal;
     if (this->_tree->intersect(ray, node, position, normal))
     {
+        CS6620_STATS_ADD(HITS, 1);
+
         // Direct lighting.
         //result += this->_shader->shade(object, position, normal, scene->lights);
         result = vec3(0, 0, 0);
@@ -161,4 +239,16 @@ vec3 Scene::shade(const Ray &ray)
 }
 
 
+bool Scene::occluded(const Ray &ray, f32 tmax) const
+{
+    CS6620_STATS_ADD(SHADOW_RAYS, 1);
+
+    if (this->_tree->occluded(ray, tmax))
+    {
+        CS6620_STATS_ADD(HITS, 1);
+        return true;
+    }
+    return false;
+}
+
 CS6620_NAMESPACE_END
@@ -19,12 +19,16 @@
 #include "cyMatrix.h"
 #include "cyVector.h"
 
+#include "arena.hpp"
+#include "bvh.hpp"
+
 CS6620_NAMESPACE_BEGIN
 
 class Camera;
 class SceneNode;
 class Tree;
 class Ray;
+class ThreadPool;
 
 /**
  * The world space is z-up
@@ -45,22 +49,63 @@ public:
      */
     virtual ~Scene();
     /**
-     * Load the scene from .xml file.
+     * Load the scene from .xml file or a snapshot written by save().
      * @param sceneFile the scene file path.
      * @return true if load succeeds.
      */
     bool load(const char *sceneFile) noexcept;
+    /**
+     * Write the scene to a binary snapshot, together with the BVHs if it's
+     * prepared, which loads much faster than the .xml file.
+     * @param snapshotFile the snapshot file path.
+     * @return true if it succeeds.
+     */
+    bool save(const char *snapshotFile) const noexcept;
 
     /**
      * Pre-process the scene for following path tracing, e.g., build accelerate
      * data structure for intersection.
+     * @param bvhCacheDirectory the directory to cache the built BVHs in, so
+     * they are mapped instead of built again on the next launch. nullptr
+     * turns the cache off.
+     * @param bvhWidth the children per node of the scene BVH in the
+     * traversal, i.e., 2 for the binary one or 4 or 8 for the wide ones.
+     * @param bvhBuilder how to build the scene BVH.
+     * @param pool the threads to build with, e.g., the ones to render with
+     * afterwards. nullptr builds on the calling thread.
+     */
+    void prepare(const char *bvhCacheDirectory = nullptr, u32 bvhWidth = 2, BVHBuilder bvhBuilder = BVHBuilder::SAH,
+        ThreadPool *pool = nullptr) noexcept;
+    /**
+     * Bring the prepared scene up to date after its nodes were moved by
+     * GeometricNode::setLocalTransform(), e.g., for the next frame of an
+     * animation. The BVH is refit to the nodes bottom up, which is far
+     * cheaper than building it, until its SAH cost degrades too much.
+     * @param rebuildThreshold how many times the SAH cost at the last build
+     * the refit BVH may reach before it's rebuilt instead.
+     * @param pool the threads to rebuild with, e.g., the ones to render
+     * with. nullptr rebuilds on the calling thread.
+     * @return true if the BVH was rebuilt.
      */
-    void prepare() noexcept;
+    bool update(f32 rebuildThreshold = 1.5f, ThreadPool *pool = nullptr) noexcept;
+    /**
+     * The statistics of the arena holding the scene nodes. Its allocations
+     * would each be a heap allocation without it, while its blocks are the
+     * ones actually made.
+     */
+    Arena::Stats arenaStats() const { return this->_arena.stats(); }
 
     /**
      * Compute the result color of the ray shooting from image plane.
      */
-    vec3 shade(const Ray &ray);
+    vec3 shade(const Ray &ray) const;
+    /**
+     * If anything blocks the ray closer than tmax, e.g., a shadow ray from a
+     * shaded point toward a light at distance tmax. It's counted as a
+     * shadow ray and takes the any-hit query, which is cheaper than
+     * finding the nearest hit.
+     */
+    bool occluded(const Ray &ray, f32 tmax) const;
 protected:
     /**
      * Destroy the scene.
@@ -68,7 +113,11 @@ protected:
     void _destroy();
 
 private:
-    Tree *_tree = nullptr; /**< The intersection acceleration object. */
+    Tree *_tree = nullptr;      /**< The intersection acceleration object. */
+    BVH  *_cachedBVH = nullptr; /**< The BVH over the nodes from the snapshot, if any. */
+    Arena _arena;               /**< Where the scene nodes live. */
+
+    friend class SceneSnapshot;
 };
 
 
@@ -16,8 +16,10 @@ CS6620_NAMESPACE_BEGIN
 //
 // class SceneNode
 //
-SceneNode::SceneNode(const char *nameStr, SceneNode *parent)
-    : name(nameStr)
+SceneNode::SceneNode(Arena *arena, const char *nameStr, SceneNode *parent)
+    : name(arena->copy(nameStr))
+    , children(ArenaAllocator<SceneNode *>(arena))
+    , _arena(arena)
 {
     this->type = Type::UNKNOWN;
 
@@ -37,7 +39,7 @@ SceneNode::~SceneNode()
 
 bool SceneNode::unserialize(tinyxml2::XMLElement *xmlElement) noexcept
 {
-    this->name = xmlElement->Attribute("name");
+    this->name = this->_arena->copy(xmlElement->Attribute("name"));
 
     return true;
 }
@@ -45,8 +47,8 @@ bool SceneNode::unserialize(tinyxml2::XMLElement *xmlElement) noexcept
 //
 // class GeometricNode
 //
-GeometricNode::GeometricNode(const char *name, SceneNode *parent) 
-    : SceneNode(name, parent)
+GeometricNode::GeometricNode(Arena *arena, const char *name, SceneNode *parent) 
+    : SceneNode(arena, name, parent)
 {
     this->type = SceneNode::Type::GEOMETRY;
 }
@@ -81,6 +83,12 @@ bool GeometricNode::unserialize(tinyxml2::XMLElement *xmlElement) noexcept
 {
     SceneNode::unserialize(xmlElement);
 
+    const char *material = xmlElement->Attribute("material");
+    if (material != nullptr)
+    {
+        this->material = this->_arena->copy(material);
+    }
+
     tinyxml2::XMLElement *childElement = xmlElement->FirstChildElement();
 
     bool seenTranslate = false;
@@ -125,6 +133,8 @@ bool GeometricNode::unserialize(tinyxml2::XMLElement *xmlElement) noexcept
     // Update the global transform.
     this->_updateGlobalTransform();
 
+    this->_onTransformChanged();
+
     if (!seenTranslate || !seenRotate || !seenScale)
     {
         LOG(WARNING) << "Doesn't see all transform about Node ''" << this->name << "'. Use default values";
@@ -132,7 +142,7 @@ bool GeometricNode::unserialize(tinyxml2::XMLElement *xmlElement) noexcept
 
     for (auto &&childXmlElement : childXmlElements)
     {
-        SceneNode *childNode = SceneNodeFactory::unserialize(childXmlElement, this);
+        SceneNode *childNode = SceneNodeFactory::unserialize(this->_arena, childXmlElement, this);
         if (childNode != nullptr)
         {
             this->children.push_back(childNode);
@@ -149,6 +159,32 @@ bool GeometricNode::unserialize(tinyxml2::XMLElement *xmlElement) noexcept
     return true;
 }
     
+void GeometricNode::prepare(const BVHCache *, ThreadPool *) noexcept
+{
+}
+
+void GeometricNode::setTransform(f32 scale, const vec3 &translate, const vec3 &rotate, const mat4 &globalTransform)
+{
+    this->scale = scale;
+    this->translate = translate;
+    this->rotate = rotate;
+
+    this->_updateTransform();
+    this->globalTransform = globalTransform;
+
+    this->_onTransformChanged();
+}
+
+void GeometricNode::setLocalTransform(f32 scale, const vec3 &translate, const vec3 &rotate)
+{
+    this->scale = scale;
+    this->translate = translate;
+    this->rotate = rotate;
+
+    this->_updateTransform();
+    this->_propagateGlobalTransform();
+}
+
 void GeometricNode::_updateTransform()
 {
     mat4 scaling;
@@ -175,8 +211,22 @@ void GeometricNode::_updateGlobalTransform()
     }
 }
 
-GeometricSphereNode::GeometricSphereNode(const char *name, SceneNode *parent)
-    : GeometricNode(name, parent)
+void GeometricNode::_propagateGlobalTransform()
+{
+    this->_updateGlobalTransform();
+    this->_onTransformChanged();
+
+    for (auto &&child : this->children)
+    {
+        if (child->type == SceneNode::Type::GEOMETRY)
+        {
+            static_cast<GeometricNode *>(child)->_propagateGlobalTransform();
+        }
+    }
+}
+
+GeometricSphereNode::GeometricSphereNode(Arena *arena, const char *name, SceneNode *parent)
+    : GeometricNode(arena, name, parent)
 {
 }
 
@@ -184,34 +234,149 @@ GeometricSphereNode::~GeometricSphereNode()
 {
 }
 
-bool GeometricSphereNode::unserialize(tinyxml2::XMLElement *xmlElement) noexcept
+void GeometricSphereNode::_onTransformChanged()
 {
-    if (!GeometricNode::unserialize(xmlElement))
+    this->_position.x = this->globalTransform[12];
+    this->_position.y = this->globalTransform[13];
+    this->_position.z = this->globalTransform[14];
+
+    // The length of the first axis is the scale. Note the row would also
+    // contain the translation.
+    this->_radius = this->globalTransform.GetColumn(0).XYZ().Length();
+}
+
+bool GeometricSphereNode::intersect(const Ray &ray, f32 &inout_distance, vec3 &out_position, vec3 &out_normal) const noexcept
+{
+    // Solve |o + t * d - c|^2 = r^2 with a unit length d. The discriminant
+    // b^2 - |o - c|^2 + r^2 is computed from the distance between the center
+    // and the ray, which doesn't cancel catastrophically.
+    vec3 oc = ray.origin - this->_position;
+    f32 b = oc.Dot(ray.direction);
+    vec3 perpendicular = oc - ray.direction * b;
+
+    f32 discriminant = this->_radius * this->_radius - perpendicular.LengthSquared();
+    if (discriminant < 0.0f)
     {
         return false;
     }
 
-    this->_position.x = this->globalTransform[12];
-    this->_position.y = this->globalTransform[13];
-    this->_position.z = this->globalTransform[14];
+    // Take the near root unless the origin is inside the sphere.
+    f32 root = cy::Sqrt(discriminant);
+    f32 t = -b - root;
+    if (t <= RAY_EPSILON)
+    {
+        t = -b + root;
+    }
+    if (t <= RAY_EPSILON || t >= inout_distance)
+    {
+        return false;
+    }
 
-    this->_radius = this->globalTransform.GetRow(0).Length();
+    inout_distance = t;
+    out_position = ray.origin + ray.direction * t;
+    out_normal = (out_position - this->_position) / this->_radius;
 
     return true;
 }
 
-bool GeometricSphereNode::intersect(const Ray &ray, vec3 &out_position, vec3 &out_normal) noexcept
+AABB GeometricSphereNode::bounds() const noexcept
 {
-    // The projection of the distance between sphere and ray origin onto the ray direction.
-    vec3 direction = this->_position - ray.origin;
-    f32 projection = direction.Dot(ray.direction);
+    vec3 r(this->_radius, this->_radius, this->_radius);
+    return AABB(this->_position - r, this->_position + r);
+}
 
-    // Compute the distance from the sphere center to the ray direction.
-    f32 distance2 = direction.LengthSquared() - projection * projection;
+//
+// class GeometricMeshNode
+//
+GeometricMeshNode::GeometricMeshNode(Arena *arena, const char *name, SceneNode *parent)
+    : GeometricNode(arena, name, parent)
+{
+}
 
-    return distance2 <= this->_radius * this->_radius;
+GeometricMeshNode::~GeometricMeshNode()
+{
 }
-    
+
+bool GeometricMeshNode::unserialize(tinyxml2::XMLElement *xmlElement) noexcept
+{
+    const char *file = xmlElement->Attribute("file");
+    if (file == nullptr)
+    {
+        LOG(ERROR) << "The mesh node '" << xmlElement->Attribute("name") << "' doesn't have a file.";
+        return false;
+    }
+
+    if (!GeometricNode::unserialize(xmlElement))
+    {
+        return false;
+    }
+
+    this->_mesh = TriangleMesh::acquire(file);
+    if (this->_mesh == nullptr)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void GeometricMeshNode::_onTransformChanged()
+{
+    this->_inverseTransform = this->globalTransform.GetInverse();
+}
+
+void GeometricMeshNode::prepare(const BVHCache *cache, ThreadPool *pool) noexcept
+{
+    if (this->_mesh->built())
+    {
+        return;
+    }
+
+    this->_mesh->build(cache, pool);
+
+    LOG(INFO) << "Mesh '" << this->name << "' BVH ready with " << this->_mesh->bvh().numNodes()
+        << " nodes, depth " << this->_mesh->bvh().depth() << ".";
+}
+
+bool GeometricMeshNode::intersect(const Ray &ray, f32 &inout_distance, vec3 &out_position, vec3 &out_normal) const noexcept
+{
+    // The direction isn't normalized in object space, so the hit distance
+    // along it equals the one in world space.
+    Ray objectRay;
+    objectRay.origin = vec3(this->_inverseTransform * ray.origin);
+    objectRay.direction = vec3(this->_inverseTransform.VectorTransform(ray.direction));
+
+    u32 face;
+    if (!this->_mesh->intersect(objectRay, inout_distance, face))
+    {
+        return false;
+    }
+
+    out_position = ray.origin + ray.direction * inout_distance;
+
+    // Normals transform by the inverse transpose.
+    out_normal = vec3(this->_inverseTransform.TransposeMult(vec4(this->_mesh->normal(face), 0.0f)));
+    out_normal.Normalize();
+
+    return true;
+}
+
+AABB GeometricMeshNode::bounds() const noexcept
+{
+    // Enclose the transformed corners of the object space box.
+    AABB local = this->_mesh->bounds();
+    AABB world;
+    for (u32 i = 0; i < 8; ++i)
+    {
+        vec3 corner((i & 1) ? local.max.x : local.min.x,
+                    (i & 2) ? local.max.y : local.min.y,
+                    (i & 4) ? local.max.z : local.min.z);
+        world.grow(vec3(this->globalTransform * corner));
+    }
+
+    return world;
+}
+
 //
 // class SceneNodeFactory
 //
@@ -223,14 +388,24 @@ SceneNodeFactory::~SceneNodeFactory()
 {
 }
 
-SceneNode *SceneNodeFactory::unserialize(tinyxml2::XMLElement *xmlElement, SceneNode *parent) noexcept
+SceneNode *SceneNodeFactory::unserialize(Arena *arena, tinyxml2::XMLElement *xmlElement, SceneNode *parent) noexcept
 {
     const char *type = xmlElement->Attribute("type");
     const char *name = xmlElement->Attribute("name");
 
+    // A node failing to unserialize stays in the arena until the scene is
+    // destroyed.
     if (strncmp(type, "sphere", 6) == 0)
     {
-        GeometricSphereNode *node = new GeometricSphereNode(name, parent);
+        GeometricSphereNode *node = arena->create<GeometricSphereNode>(arena, name, parent);
+        if (node->unserialize(xmlElement))
+        {
+            return node;
+        }
+    }
+    else if (strncmp(type, "mesh", 4) == 0)
+    {
+        GeometricMeshNode *node = arena->create<GeometricMeshNode>(arena, name, parent);
         if (node->unserialize(xmlElement))
         {
             return node;
@@ -20,11 +20,15 @@
 #include "cyVector.h"
 
 #include "ray.hpp"
+#include "aabb.hpp"
+#include "mesh.hpp"
+#include "arena.hpp"
 
 CS6620_NAMESPACE_BEGIN
 
 /**
- * The base class of scene nodes.
+ * The base class of scene nodes. The nodes, their names and their child
+ * lists live in the scene's arena and are freed along with it.
  */
 class SceneNode 
 {
@@ -36,7 +40,7 @@ public:
         GEOMETRY,       /**< A geometric object. */
     } type;       
 
-    std::string name;
+    const char *name;      /**< In the arena. */
 
     f32  scale;        /**< Local transformation. */
     vec3 translate;
@@ -46,13 +50,14 @@ public:
     mat4 globalTransform; /**< The global transformation matrix. */
 
     SceneNode               *parent    = nullptr;
-    std::vector<SceneNode *> children;
+    std::vector<SceneNode *, ArenaAllocator<SceneNode *>> children;
 
 public:
     /**
      * Constructor
+     * @param arena the arena the node is created in.
      */
-    SceneNode(const char *name, SceneNode *parent);
+    SceneNode(Arena *arena, const char *name, SceneNode *parent);
     /**
      * Destructor
      */
@@ -65,6 +70,9 @@ public:
      * Convert the node's data into a xml description.
      */
     //virtual const char * serialize() noexcept = 0;
+
+protected:
+    Arena *_arena; /**< The arena of the node and its children. */
 };
 
 /**
@@ -72,11 +80,14 @@ public:
  */
 class GeometricNode : public SceneNode
 {
+public:
+    const char *material = nullptr; /**< The material name in the arena, or nullptr. */
+
 public:
     /**
      * Constructor.
      */
-    GeometricNode(const char *name, SceneNode *parent);
+    GeometricNode(Arena *arena, const char *name, SceneNode *parent);
     /**
      * Destructor.
      */
@@ -86,12 +97,45 @@ public:
      * @param xmlElement the XML node that contains information of this node.
      */
     virtual bool unserialize(tinyxml2::XMLElement *xmlElement) noexcept override;
+    /**
+     * Pre-process the node before rendering, e.g., build its own
+     * acceleration structure. Called by Scene::prepare().
+     * @param cache the BVH cache, or nullptr if it's off.
+     * @param pool the threads to build with, or nullptr.
+     */
+    virtual void prepare(const BVHCache *cache, ThreadPool *pool) noexcept;
     /**
      * If intersect with a given ray.
+     * @param ray the ray in world space.
+     * @param inout_distance the nearest hit distance so far. A hit counts
+     * only if it is closer, and then the distance is updated.
+     * @param out_position return the intersection in world coordinate.
+     * @param out_normal return the normal at the intersection point.
+     * @return true if the ray hits this node closer than inout_distance.
+     */
+    virtual bool intersect(const Ray &ray, f32 &inout_distance, vec3 &out_position, vec3 &out_normal) const noexcept = 0;
+    /**
+     * The bounding box of this node in world space.
+     */
+    virtual AABB bounds() const noexcept = 0;
+    /**
+     * Set the SRT vectors and the global transform directly rather than from
+     * the xml description, e.g., when loading a snapshot.
      */
-    virtual bool intersect(const Ray &ray, vec3 &out_position, vec3 &out_normal) noexcept = 0;
+    void setTransform(f32 scale, const vec3 &translate, const vec3 &rotate, const mat4 &globalTransform);
+    /**
+     * Move the node by new SRT vectors, e.g., for the next frame of an
+     * animation. The global transforms of the node and its descendants
+     * follow, and Scene::update() brings the scene BVH up to date once all
+     * moved nodes are set.
+     */
+    void setLocalTransform(f32 scale, const vec3 &translate, const vec3 &rotate);
 
 protected:
+    /**
+     * Called once the global transform is set up to update what depends on it.
+     */
+    virtual void _onTransformChanged() {}
     /**
      * Update the local transform from SRT vectors.
      */
@@ -100,6 +144,11 @@ protected:
      * Update the global transform from SRT vectors.
      */
     void _updateGlobalTransform();
+    /**
+     * Update the global transforms of the node and its descendants after
+     * the node or its parent moved.
+     */
+    void _propagateGlobalTransform();
     /**
      */
     void _parseScale(tinyxml2::XMLElement *xmlElement);
@@ -119,24 +168,79 @@ class GeometricSphereNode : public GeometricNode
 public:
     /**
      */
-    GeometricSphereNode(const char *name, SceneNode *parent);
+    GeometricSphereNode(Arena *arena, const char *name, SceneNode *parent);
     /**
      */
     virtual ~GeometricSphereNode();
     /**
-     * Read the parameter of the sphere node from xml doc.
+     * If intersect with a given ray in world space.
      */
-    virtual bool unserialize(tinyxml2::XMLElement *xmlElement) noexcept override;
+    virtual bool intersect(const Ray &ray, f32 &inout_distance, vec3 &out_position, vec3 &out_normal) const noexcept override;
     /**
-     * If intersect with a given ray in world space.
+     * The bounding box of the sphere in world space.
      */
-    virtual bool intersect(const Ray &ray, vec3 &out_position, vec3 &out_normal) noexcept override;
+    virtual AABB bounds() const noexcept override;
+
+    const vec3 &center() const { return this->_position; }
+
+    f32 radius() const { return this->_radius; }
+
+protected:
+    /**
+     * Take the center and the radius from the global transform.
+     */
+    virtual void _onTransformChanged() override;
 
 private:
     f32 _radius; /**< The radius of the sphere. */
     vec3 _position; /**< The position of the sphere center in world space. */
 };
 
+/**
+ * An instance of a triangle mesh loaded from an .obj file. The nodes of the
+ * same file share the mesh and its BVH in object space. The rays are moved
+ * into the object space to intersect with it.
+ */
+class GeometricMeshNode : public GeometricNode
+{
+public:
+    /**
+     */
+    GeometricMeshNode(Arena *arena, const char *name, SceneNode *parent);
+    /**
+     */
+    virtual ~GeometricMeshNode();
+    /**
+     * Read the mesh file and the transform from xml doc.
+     */
+    virtual bool unserialize(tinyxml2::XMLElement *xmlElement) noexcept override;
+    /**
+     * Build the BVH over the faces of the shared mesh if not yet.
+     */
+    virtual void prepare(const BVHCache *cache, ThreadPool *pool) noexcept override;
+    /**
+     * If intersect with a given ray in world space.
+     */
+    virtual bool intersect(const Ray &ray, f32 &inout_distance, vec3 &out_position, vec3 &out_normal) const noexcept override;
+    /**
+     * The bounding box of the mesh in world space.
+     */
+    virtual AABB bounds() const noexcept override;
+
+    const std::shared_ptr<TriangleMesh> &mesh() const { return this->_mesh; }
+
+    const mat4 &inverseTransform() const { return this->_inverseTransform; }
+
+    void setMesh(const std::shared_ptr<TriangleMesh> &mesh) { this->_mesh = mesh; }
+
+protected:
+    virtual void _onTransformChanged() override;
+
+private:
+    std::shared_ptr<TriangleMesh> _mesh; /**< The shared mesh in object space. */
+    mat4 _inverseTransform;              /**< From world space to the object space. */
+};
+
 
 class SceneNodeFactory 
 {
@@ -150,7 +254,11 @@ public:
      */
     ~SceneNodeFactory();
 
-    static SceneNode *unserialize(tinyxml2::XMLElement *xmlElement, SceneNode *parent) noexcept;
+    /**
+     * Create a node in the arena from its xml description.
+     * @return the node, or nullptr if it fails.
+     */
+    static SceneNode *unserialize(Arena *arena, tinyxml2::XMLElement *xmlElement, SceneNode *parent) noexcept;
 };
 
 
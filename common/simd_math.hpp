@@ -0,0 +1,208 @@
+/**
+ * \file simd_math.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * SSE specializations of the cy vector and matrix methods on the hot path
+ * of vec3, vec4 and mat4.
+ */
+
+#ifndef SIMD_MATH_HPP
+#define SIMD_MATH_HPP
+
+#include "cyMatrix.h"
+#include "cyVector.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+
+// The types keep their layouts, i.e., the 12-byte Vec3 that the snapshots,
+// the BVH nodes and the packed arrays are built on, so the vectors are
+// loaded into the registers and stored back around each operation. The
+// operations are done in the same order as the scalar code to give the
+// same results to the bit.
+//
+// The specializations have to be seen before any use of the methods, so
+// this is included by common.h right after the cy headers.
+
+namespace cy {
+
+//! \cond HIDDEN_SYMBOLS
+namespace _simd {
+
+inline __m128 Load3(Vec3<float> const &v) { return _mm_setr_ps(v.x, v.y, v.z, 0.0f); }
+inline __m128 Load4(Vec4<float> const &v) { return _mm_loadu_ps(v.elem); }
+inline Vec3<float> Store3(__m128 v)
+{
+    alignas(16) float r[4];
+    _mm_store_ps(r, v);
+    return Vec3<float>(r[0], r[1], r[2]);
+}
+inline Vec4<float> Store4(__m128 v)
+{
+    Vec4<float> r;
+    _mm_storeu_ps(r.elem, v);
+    return r;
+}
+template <int I> inline __m128 Broadcast(__m128 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(I, I, I, I)); }
+
+//! The sum of the first three lanes as ((x + y) + z), in the lowest lane.
+inline __m128 Sum3(__m128 v) { return _mm_add_ss(_mm_add_ss(v, Broadcast<1>(v)), Broadcast<2>(v)); }
+//! The sum of all lanes as (((x + y) + z) + w), in the lowest lane.
+inline __m128 Sum4(__m128 v) { return _mm_add_ss(Sum3(v), Broadcast<3>(v)); }
+
+//! The matrix times a vector given by its broadcast lanes, with the
+//! products summed as the scalar code does.
+inline __m128 Transform(float const *cell, __m128 x, __m128 y, __m128 z)
+{
+    __m128 a = _mm_mul_ps(x, _mm_loadu_ps(cell + 0));
+    __m128 b = _mm_mul_ps(y, _mm_loadu_ps(cell + 4));
+    __m128 c = _mm_mul_ps(z, _mm_loadu_ps(cell + 8));
+    return _mm_add_ps(_mm_add_ps(a, b), c);
+}
+
+} // namespace _simd
+//! \endcond
+
+//-------------------------------------------------------------------------------
+// Vec3<float>
+
+template <> inline float Vec3<float>::Dot(Vec3<float> const &p) const
+{
+    return _mm_cvtss_f32(_simd::Sum3(_mm_mul_ps(_simd::Load3(*this), _simd::Load3(p))));
+}
+
+template <> inline float Vec3<float>::LengthSquared() const
+{
+    __m128 v = _simd::Load3(*this);
+    return _mm_cvtss_f32(_simd::Sum3(_mm_mul_ps(v, v)));
+}
+
+template <> inline float Vec3<float>::Length() const
+{
+    __m128 v = _simd::Load3(*this);
+    return _mm_cvtss_f32(_mm_sqrt_ss(_simd::Sum3(_mm_mul_ps(v, v))));
+}
+
+template <> inline Vec3<float> Vec3<float>::GetNormalized() const
+{
+    __m128 v = _simd::Load3(*this);
+    __m128 length = _mm_sqrt_ss(_simd::Sum3(_mm_mul_ps(v, v)));
+    return _simd::Store3(_mm_div_ps(v, _simd::Broadcast<0>(length)));
+}
+
+template <> inline void Vec3<float>::Normalize()
+{
+    *this = this->GetNormalized();
+}
+
+template <> inline Vec3<float> Vec3<float>::Cross(Vec3<float> const &p) const
+{
+    __m128 a = _simd::Load3(*this);
+    __m128 b = _simd::Load3(p);
+    __m128 ayzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 azxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+    __m128 byzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 bzxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+    return _simd::Store3(_mm_sub_ps(_mm_mul_ps(ayzx, bzxy), _mm_mul_ps(azxy, byzx)));
+}
+
+//-------------------------------------------------------------------------------
+// Vec4<float>
+
+template <> inline float Vec4<float>::Dot(Vec4<float> const &p) const
+{
+    return _mm_cvtss_f32(_simd::Sum4(_mm_mul_ps(_simd::Load4(*this), _simd::Load4(p))));
+}
+
+template <> inline float Vec4<float>::LengthSquared() const
+{
+    __m128 v = _simd::Load4(*this);
+    return _mm_cvtss_f32(_simd::Sum4(_mm_mul_ps(v, v)));
+}
+
+template <> inline float Vec4<float>::Length() const
+{
+    __m128 v = _simd::Load4(*this);
+    return _mm_cvtss_f32(_mm_sqrt_ss(_simd::Sum4(_mm_mul_ps(v, v))));
+}
+
+template <> inline Vec4<float> Vec4<float>::GetNormalized() const
+{
+    __m128 v = _simd::Load4(*this);
+    __m128 length = _mm_sqrt_ss(_simd::Sum4(_mm_mul_ps(v, v)));
+    return _simd::Store4(_mm_div_ps(v, _simd::Broadcast<0>(length)));
+}
+
+template <> inline void Vec4<float>::Normalize()
+{
+    *this = this->GetNormalized();
+}
+
+//-------------------------------------------------------------------------------
+// Matrix4<float>
+
+template <> inline Matrix4<float> Matrix4<float>::operator * (Matrix4<float> const &right) const
+{
+    Matrix4<float> r;
+    __m128 c0 = _mm_loadu_ps(cell + 0);
+    __m128 c1 = _mm_loadu_ps(cell + 4);
+    __m128 c2 = _mm_loadu_ps(cell + 8);
+    __m128 c3 = _mm_loadu_ps(cell + 12);
+    for (int i = 0; i < 16; i += 4)
+    {
+        __m128 a = _mm_mul_ps(c0, _mm_set1_ps(right.cell[i    ]));
+        __m128 b = _mm_mul_ps(c1, _mm_set1_ps(right.cell[i + 1]));
+        __m128 c = _mm_mul_ps(c2, _mm_set1_ps(right.cell[i + 2]));
+        __m128 d = _mm_mul_ps(c3, _mm_set1_ps(right.cell[i + 3]));
+        _mm_storeu_ps(r.cell + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(a, b), c), d));
+    }
+    return r;
+}
+
+template <> inline Vec4<float> Matrix4<float>::operator * (Vec3<float> const &p) const
+{
+    __m128 r = _simd::Transform(cell, _mm_set1_ps(p.x), _mm_set1_ps(p.y), _mm_set1_ps(p.z));
+    return _simd::Store4(_mm_add_ps(r, _mm_loadu_ps(cell + 12)));
+}
+
+template <> inline Vec4<float> Matrix4<float>::operator * (Vec4<float> const &p) const
+{
+    __m128 v = _simd::Load4(p);
+    __m128 a = _mm_mul_ps(_simd::Broadcast<0>(v), _mm_loadu_ps(cell + 0));
+    __m128 b = _mm_mul_ps(_simd::Broadcast<1>(v), _mm_loadu_ps(cell + 4));
+    __m128 c = _mm_mul_ps(_simd::Broadcast<2>(v), _mm_loadu_ps(cell + 8));
+    __m128 d = _mm_mul_ps(_simd::Broadcast<3>(v), _mm_loadu_ps(cell + 12));
+    return _simd::Store4(_mm_add_ps(_mm_add_ps(a, c), _mm_add_ps(b, d)));
+}
+
+template <> inline Vec4<float> Matrix4<float>::VectorTransform(Vec3<float> const &p) const
+{
+    return _simd::Store4(_simd::Transform(cell, _mm_set1_ps(p.x), _mm_set1_ps(p.y), _mm_set1_ps(p.z)));
+}
+
+template <> inline Vec4<float> Matrix4<float>::TransposeMult(Vec4<float> const &p) const
+{
+    // The rows of the transpose are the columns, so transpose them into
+    // rows to sum the dot products lane by lane.
+    __m128 r0 = _mm_loadu_ps(cell + 0);
+    __m128 r1 = _mm_loadu_ps(cell + 4);
+    __m128 r2 = _mm_loadu_ps(cell + 8);
+    __m128 r3 = _mm_loadu_ps(cell + 12);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    __m128 v = _simd::Load4(p);
+    __m128 a = _mm_mul_ps(_simd::Broadcast<0>(v), r0);
+    __m128 b = _mm_mul_ps(_simd::Broadcast<1>(v), r1);
+    __m128 c = _mm_mul_ps(_simd::Broadcast<2>(v), r2);
+    __m128 d = _mm_mul_ps(_simd::Broadcast<3>(v), r3);
+    return _simd::Store4(_mm_add_ps(_mm_add_ps(_mm_add_ps(a, b), c), d));
+}
+
+} // namespace cy
+
+#endif
+
+
+#endif // !SIMD_MATH_HPP
@@ -0,0 +1,445 @@
+/**
+ * \file snapshot.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The binary snapshot of a scene, which loads without parsing.
+ */
+
+#include "snapshot.hpp"
+
+#include "scene.hpp"
+#include "scene_node.hpp"
+#include "camera.hpp"
+#include "bvh_tree.hpp"
+#include "mapped_file.hpp"
+#include "profiler.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+CS6620_NAMESPACE_BEGIN
+
+static u64 _Align(u64 offset)
+{
+    return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+static void _Store(const vec3 &v, f32 *out)
+{
+    out[0] = v.x;
+    out[1] = v.y;
+    out[2] = v.z;
+}
+
+static vec3 _Load(const f32 *v)
+{
+    return vec3(v[0], v[1], v[2]);
+}
+
+bool SceneSnapshot::test(const char *file) noexcept
+{
+    FILE *fp = fopen(file, "rb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    bool ret = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+    fclose(fp);
+    return ret;
+}
+
+bool SceneSnapshot::write(const Scene *scene, const char *file) noexcept
+{
+    CS6620_PROFILE_SCOPE("Snapshot write");
+
+    // Collect the nodes in the same order as the tree does, so the indices
+    // of the scene level BVH refer to the same nodes.
+    std::vector<const GeometricNode *> nodes;
+    std::map<const SceneNode *, u32> nodeIndices;
+    std::list<const SceneNode *> queue(scene->root->children.begin(), scene->root->children.end());
+    while (!queue.empty())
+    {
+        const SceneNode *node = queue.front();
+        queue.pop_front();
+
+        queue.insert(queue.end(), node->children.begin(), node->children.end());
+
+        assert(node->type == SceneNode::Type::GEOMETRY);
+        nodeIndices[node] = (u32)nodes.size();
+        nodes.push_back(static_cast<const GeometricNode *>(node));
+    }
+
+    std::string strings;
+    auto addString = [&strings](const std::string &s)
+    {
+        u32 offset = (u32)strings.size();
+        strings += s;
+        strings.push_back('\0');
+        return offset;
+    };
+
+    // Fill the node records and find the meshes shared by them.
+    std::vector<SnapshotNode> nodeRecords(nodes.size());
+    std::vector<const TriangleMesh *> meshes;
+    std::map<const TriangleMesh *, u32> meshIndices;
+    for (u32 i = 0; i < (u32)nodes.size(); ++i)
+    {
+        const GeometricNode *node = nodes[i];
+        SnapshotNode &record = nodeRecords[i];
+        memset(&record, 0, sizeof(record));
+
+        record.parent = node->parent == scene->root ? SNAPSHOT_NONE : nodeIndices[node->parent];
+        record.name = addString(node->name);
+        record.mesh = SNAPSHOT_NONE;
+        record.material = node->material != nullptr ? addString(node->material) : SNAPSHOT_NONE;
+        record.scale = node->scale;
+        _Store(node->translate, record.translate);
+        _Store(node->rotate, record.rotate);
+        memcpy(record.globalTransform, node->globalTransform.cell, sizeof(record.globalTransform));
+
+        const GeometricMeshNode *meshNode = dynamic_cast<const GeometricMeshNode *>(node);
+        if (meshNode != nullptr)
+        {
+            const TriangleMesh *mesh = meshNode->mesh().get();
+            if (meshIndices.find(mesh) == meshIndices.end())
+            {
+                meshIndices[mesh] = (u32)meshes.size();
+                meshes.push_back(mesh);
+            }
+
+            record.type = SnapshotNode::MESH;
+            record.mesh = meshIndices[mesh];
+        }
+        else if (dynamic_cast<const GeometricSphereNode *>(node) != nullptr)
+        {
+            record.type = SnapshotNode::SPHERE;
+        }
+        else
+        {
+            LOG(ERROR) << "The node '" << node->name << "' can't be saved to a snapshot.";
+            return false;
+        }
+    }
+
+    const BVHTree *tree = dynamic_cast<const BVHTree *>(scene->_tree);
+    const BVH *treeBVH = tree != nullptr ? &tree->bvh() : nullptr;
+
+    // Lay out the sections.
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.numNodes = (u32)nodes.size();
+    header.numMeshes = (u32)meshes.size();
+
+    u64 offset = _Align(sizeof(SnapshotHeader));
+    header.nodesOffset = offset;
+    offset = _Align(offset + sizeof(SnapshotNode) * nodes.size());
+    header.meshesOffset = offset;
+    offset = _Align(offset + sizeof(SnapshotMesh) * meshes.size());
+
+    std::vector<SnapshotMesh> meshRecords(meshes.size());
+    for (u32 i = 0; i < (u32)meshes.size(); ++i)
+    {
+        const TriangleMesh *mesh = meshes[i];
+        SnapshotMesh &record = meshRecords[i];
+        memset(&record, 0, sizeof(record));
+
+        record.file = addString(mesh->file());
+        record.numVertices = mesh->numVertices();
+        record.numFaces = mesh->numFaces();
+        record.numBVHNodes = mesh->bvh().numNodes();
+        record.bvhDepth = mesh->bvh().depth();
+
+        record.xOffset = offset;
+        offset = _Align(offset + sizeof(f32) * record.numVertices);
+        record.yOffset = offset;
+        offset = _Align(offset + sizeof(f32) * record.numVertices);
+        record.zOffset = offset;
+        offset = _Align(offset + sizeof(f32) * record.numVertices);
+        record.facesOffset = offset;
+        offset = _Align(offset + sizeof(u32) * 3 * record.numFaces);
+        record.bvhNodesOffset = offset;
+        offset = _Align(offset + sizeof(BVHNode) * record.numBVHNodes);
+        record.bvhIndicesOffset = offset;
+        offset = _Align(offset + sizeof(u32) * mesh->bvh().numIndices());
+    }
+
+    if (treeBVH != nullptr && treeBVH->numIndices() == nodes.size())
+    {
+        header.numTreeNodes = treeBVH->numNodes();
+        header.treeDepth = treeBVH->depth();
+        header.treeNodesOffset = offset;
+        offset = _Align(offset + sizeof(BVHNode) * header.numTreeNodes);
+        header.treeIndicesOffset = offset;
+        offset = _Align(offset + sizeof(u32) * treeBVH->numIndices());
+    }
+
+    header.stringsOffset = offset;
+    header.stringsSize = strings.size();
+    offset += strings.size();
+    header.fileSize = offset;
+
+    const Camera *camera = scene->camera;
+    _Store(camera->position, header.camera.position);
+    _Store(camera->target, header.camera.target);
+    _Store(camera->up, header.camera.up);
+    header.camera.fovy = camera->fovy;
+    header.camera.width = camera->width;
+    header.camera.height = camera->height;
+    _Store(camera->nearo, header.camera.nearo);
+    _Store(camera->nearx, header.camera.nearx);
+    _Store(camera->nearz, header.camera.nearz);
+
+    // Assemble the file in memory and write it at once.
+    std::vector<u8> buffer((size_t)header.fileSize, 0);
+    u8 *data = buffer.data();
+    auto put = [data](u64 offset, const void *source, size_t size)
+    {
+        if (size > 0)
+        {
+            memcpy(data + offset, source, size);
+        }
+    };
+
+    put(0, &header, sizeof(header));
+    put(header.nodesOffset, nodeRecords.data(), sizeof(SnapshotNode) * nodeRecords.size());
+    put(header.meshesOffset, meshRecords.data(), sizeof(SnapshotMesh) * meshRecords.size());
+    for (u32 i = 0; i < (u32)meshes.size(); ++i)
+    {
+        const TriangleMesh *mesh = meshes[i];
+        const SnapshotMesh &record = meshRecords[i];
+        put(record.xOffset, mesh->x(), sizeof(f32) * record.numVertices);
+        put(record.yOffset, mesh->y(), sizeof(f32) * record.numVertices);
+        put(record.zOffset, mesh->z(), sizeof(f32) * record.numVertices);
+        put(record.facesOffset, mesh->faces(), sizeof(u32) * 3 * record.numFaces);
+        put(record.bvhNodesOffset, mesh->bvh().nodes(), sizeof(BVHNode) * record.numBVHNodes);
+        put(record.bvhIndicesOffset, mesh->bvh().indices(), sizeof(u32) * mesh->bvh().numIndices());
+    }
+    if (header.numTreeNodes > 0)
+    {
+        put(header.treeNodesOffset, treeBVH->nodes(), sizeof(BVHNode) * header.numTreeNodes);
+        put(header.treeIndicesOffset, treeBVH->indices(), sizeof(u32) * treeBVH->numIndices());
+    }
+    put(header.stringsOffset, strings.data(), strings.size());
+
+    FILE *fp = fopen(file, "wb");
+    if (fp == nullptr)
+    {
+        LOG(ERROR) << "Fail to write to " << file;
+        return false;
+    }
+    bool ret = fwrite(data, 1, buffer.size(), fp) == buffer.size();
+    ret = fclose(fp) == 0 && ret;
+    if (!ret)
+    {
+        LOG(ERROR) << "Fail to write to " << file;
+        return false;
+    }
+
+    LOG(INFO) << "Snapshot '" << file << "' written with " << header.numNodes << " nodes and "
+        << header.numMeshes << " meshes in " << header.fileSize << " bytes.";
+
+    return true;
+}
+
+/**
+ * If all the primitive indices of a saved BVH are below the number of
+ * primitives, which BVH::validate() doesn't look at.
+ */
+static bool _IndicesBelow(const u32 *indices, u32 numIndices, u32 numPrimitives)
+{
+    for (u32 i = 0; i < numIndices; ++i)
+    {
+        if (indices[i] >= numPrimitives)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SceneSnapshot::load(Scene *scene, const char *file) noexcept
+{
+    CS6620_PROFILE_SCOPE("Snapshot load");
+
+    assert(scene->root == nullptr && scene->camera == nullptr);
+
+    std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+    if (!mapping->open(file))
+    {
+        return false;
+    }
+
+    const u8 *data = mapping->data();
+    u64 size = mapping->size();
+
+    // The sections must lie inside the file and be aligned for their types.
+    auto inside = [size](u64 offset, u64 count, u64 elementSize)
+    {
+        return offset % SNAPSHOT_ALIGNMENT == 0 && offset <= size && count <= (size - offset) / elementSize;
+    };
+
+    const SnapshotHeader *header = (const SnapshotHeader *)data;
+    if (size < sizeof(SnapshotHeader) || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0)
+    {
+        LOG(ERROR) << "'" << file << "' is not a scene snapshot.";
+        return false;
+    }
+    if (header->version != SNAPSHOT_VERSION || header->byteOrder != SNAPSHOT_BYTE_ORDER)
+    {
+        LOG(ERROR) << "The snapshot '" << file << "' is of version " << header->version
+            << " or byte order, which is not supported. Write it again from the scene.";
+        return false;
+    }
+    if (header->fileSize != size
+        || !inside(header->nodesOffset, header->numNodes, sizeof(SnapshotNode))
+        || !inside(header->meshesOffset, header->numMeshes, sizeof(SnapshotMesh))
+        || !inside(header->treeNodesOffset, header->numTreeNodes, sizeof(BVHNode))
+        || !inside(header->treeIndicesOffset, header->numTreeNodes > 0 ? header->numNodes : 0, sizeof(u32))
+        || header->stringsOffset > size || header->stringsSize != size - header->stringsOffset
+        || (header->stringsSize > 0 && data[size - 1] != '\0'))
+    {
+        LOG(ERROR) << "The snapshot '" << file << "' is broken.";
+        return false;
+    }
+
+    const SnapshotNode *nodeRecords = (const SnapshotNode *)(data + header->nodesOffset);
+    const SnapshotMesh *meshRecords = (const SnapshotMesh *)(data + header->meshesOffset);
+    const char *strings = (const char *)(data + header->stringsOffset);
+
+    // Map the meshes.
+    std::vector<std::shared_ptr<TriangleMesh>> meshes(header->numMeshes);
+    for (u32 i = 0; i < header->numMeshes; ++i)
+    {
+        const SnapshotMesh &record = meshRecords[i];
+        u32 numIndices = record.numBVHNodes > 0 ? record.numFaces : 0;
+        if (record.file >= header->stringsSize
+            || !inside(record.xOffset, record.numVertices, sizeof(f32))
+            || !inside(record.yOffset, record.numVertices, sizeof(f32))
+            || !inside(record.zOffset, record.numVertices, sizeof(f32))
+            || !inside(record.facesOffset, (u64)record.numFaces * 3, sizeof(u32))
+            || !inside(record.bvhNodesOffset, record.numBVHNodes, sizeof(BVHNode))
+            || !inside(record.bvhIndicesOffset, numIndices, sizeof(u32))
+            || !BVH::validate((const BVHNode *)(data + record.bvhNodesOffset), record.numBVHNodes, numIndices)
+            || !_IndicesBelow((const u32 *)(data + record.bvhIndicesOffset), numIndices, record.numFaces))
+        {
+            LOG(ERROR) << "The snapshot '" << file << "' is broken.";
+            return false;
+        }
+
+        const u32 *faces = (const u32 *)(data + record.facesOffset);
+        for (u32 j = 0; j < record.numFaces * 3; ++j)
+        {
+            if (faces[j] >= record.numVertices)
+            {
+                LOG(ERROR) << "The snapshot '" << file << "' is broken.";
+                return false;
+            }
+        }
+
+        BVH bvh;
+        if (record.numBVHNodes > 0)
+        {
+            bvh.map((const BVHNode *)(data + record.bvhNodesOffset), record.numBVHNodes,
+                (const u32 *)(data + record.bvhIndicesOffset), numIndices, record.bvhDepth, mapping);
+        }
+
+        meshes[i] = std::make_shared<TriangleMesh>();
+        meshes[i]->map(strings + record.file,
+            (const f32 *)(data + record.xOffset), (const f32 *)(data + record.yOffset), (const f32 *)(data + record.zOffset),
+            record.numVertices, faces, record.numFaces, bvh, mapping);
+    }
+
+    // Recreate the nodes. A parent always comes before its children.
+    Arena *arena = &scene->_arena;
+    scene->root = arena->create<SceneNode>(arena, "root", nullptr);
+
+    std::vector<GeometricNode *> nodes(header->numNodes);
+    for (u32 i = 0; i < header->numNodes; ++i)
+    {
+        const SnapshotNode &record = nodeRecords[i];
+        if ((record.parent != SNAPSHOT_NONE && record.parent >= i) || record.name >= header->stringsSize
+            || (record.material != SNAPSHOT_NONE && record.material >= header->stringsSize)
+            || (record.type == SnapshotNode::MESH && record.mesh >= header->numMeshes))
+        {
+            LOG(ERROR) << "The snapshot '" << file << "' is broken.";
+            return false;
+        }
+
+        SceneNode *parent = record.parent == SNAPSHOT_NONE ? scene->root : nodes[record.parent];
+        const char *name = strings + record.name;
+
+        GeometricNode *node = nullptr;
+        if (record.type == SnapshotNode::SPHERE)
+        {
+            node = arena->create<GeometricSphereNode>(arena, name, parent);
+        }
+        else if (record.type == SnapshotNode::MESH)
+        {
+            GeometricMeshNode *meshNode = arena->create<GeometricMeshNode>(arena, name, parent);
+            meshNode->setMesh(meshes[record.mesh]);
+            node = meshNode;
+        }
+        else
+        {
+            LOG(ERROR) << "The snapshot '" << file << "' is broken.";
+            return false;
+        }
+
+        mat4 globalTransform;
+        memcpy(globalTransform.cell, record.globalTransform, sizeof(record.globalTransform));
+        node->setTransform(record.scale, _Load(record.translate), _Load(record.rotate), globalTransform);
+        if (record.material != SNAPSHOT_NONE)
+        {
+            node->material = arena->copy(strings + record.material);
+        }
+
+        parent->children.push_back(node);
+        nodes[i] = node;
+    }
+
+    // Keep the scene level BVH for prepare().
+    if (header->numTreeNodes > 0)
+    {
+        if (!BVH::validate((const BVHNode *)(data + header->treeNodesOffset), header->numTreeNodes, header->numNodes)
+            || !_IndicesBelow((const u32 *)(data + header->treeIndicesOffset), header->numNodes, header->numNodes))
+        {
+            LOG(ERROR) << "The snapshot '" << file << "' is broken.";
+            return false;
+        }
+
+        scene->_cachedBVH = new BVH();
+        scene->_cachedBVH->map((const BVHNode *)(data + header->treeNodesOffset), header->numTreeNodes,
+            (const u32 *)(data + header->treeIndicesOffset), header->numNodes, header->treeDepth, mapping);
+    }
+
+    Camera *camera = new Camera();
+    camera->position = _Load(header->camera.position);
+    camera->target = _Load(header->camera.target);
+    camera->up = _Load(header->camera.up);
+    camera->fovy = header->camera.fovy;
+    camera->width = (u16)header->camera.width;
+    camera->height = (u16)header->camera.height;
+    camera->nearo = _Load(header->camera.nearo);
+    camera->nearx = _Load(header->camera.nearx);
+    camera->nearz = _Load(header->camera.nearz);
+    scene->camera = camera;
+
+    LOG(INFO) << "Snapshot '" << file << "' loaded with " << header->numNodes << " nodes and "
+        << header->numMeshes << " meshes.";
+
+    return true;
+}
+
+CS6620_NAMESPACE_END
@@ -0,0 +1,134 @@
+/**
+ * \file snapshot.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The binary snapshot of a scene, which loads without parsing.
+ */
+
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "common.h"
+
+CS6620_NAMESPACE_BEGIN
+
+class Scene;
+
+/**
+ * The snapshot file starts with a SnapshotHeader followed by sections of
+ * plain arrays, each aligned to SNAPSHOT_ALIGNMENT and located by its
+ * offset from the start of the file:
+ *
+ * - the nodes in breadth-first order, so a parent always comes first,
+ * - the meshes, each with its vertices, faces and optionally its BVH,
+ * - optionally the BVH over the nodes,
+ * - the zero terminated strings.
+ *
+ * The file is written in the native byte order and loaded by mapping it
+ * into memory. The mesh arrays and the BVHs are used right from the
+ * mapping, while the nodes are recreated from their records.
+ */
+static const char SNAPSHOT_MAGIC[8] = { 'C', 'S', '6', '6', '2', '0', 'S', 'S' };
+static const u32  SNAPSHOT_VERSION = 2;
+static const u32  SNAPSHOT_BYTE_ORDER = 0x01020304;
+static const u32  SNAPSHOT_ALIGNMENT = 64;
+static const u32  SNAPSHOT_NONE = 0xffffffff;
+
+struct SnapshotCamera
+{
+    f32 position[3];
+    f32 target[3];
+    f32 up[3];
+    f32 fovy;
+    u32 width;
+    u32 height;
+    f32 nearo[3];
+    f32 nearx[3];
+    f32 nearz[3];
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    u32  version;
+    u32  byteOrder;     /**< SNAPSHOT_BYTE_ORDER as written by the machine. */
+    u64  fileSize;
+
+    u32  numNodes;
+    u32  numMeshes;
+    u32  numTreeNodes;  /**< The number of nodes of the BVH over the nodes. 0 if not saved. */
+    u32  treeDepth;
+    u64  nodesOffset;
+    u64  meshesOffset;
+    u64  treeNodesOffset;
+    u64  treeIndicesOffset;
+    u64  stringsOffset;
+    u64  stringsSize;
+
+    SnapshotCamera camera;
+};
+
+struct SnapshotNode
+{
+    enum Type
+    {
+        SPHERE = 1,
+        MESH   = 2,
+    };
+
+    u32 type;
+    u32 parent;           /**< The index of the parent node, or SNAPSHOT_NONE under the root. */
+    u32 name;             /**< The offset of the name in the strings. */
+    u32 mesh;             /**< The index of the mesh, or SNAPSHOT_NONE. */
+    u32 material;         /**< The offset of the material name in the strings, or SNAPSHOT_NONE. */
+    f32 scale;
+    f32 translate[3];
+    f32 rotate[3];
+    f32 globalTransform[16];
+};
+
+struct SnapshotMesh
+{
+    u32 file;             /**< The offset of the .obj file path in the strings. */
+    u32 numVertices;
+    u32 numFaces;
+    u32 numBVHNodes;      /**< 0 if the BVH isn't saved. */
+    u32 bvhDepth;
+    u32 reserved;
+    u64 xOffset;
+    u64 yOffset;
+    u64 zOffset;
+    u64 facesOffset;
+    u64 bvhNodesOffset;
+    u64 bvhIndicesOffset;
+};
+
+/**
+ * Write and load the scene snapshots.
+ */
+class SceneSnapshot
+{
+public:
+    /**
+     * If the file is a snapshot, judging from its magic number.
+     */
+    static bool test(const char *file) noexcept;
+    /**
+     * Write the scene to a snapshot. The BVHs built so far are saved along,
+     * so call it after Scene::prepare() to skip building them at load.
+     * @return true if it succeeds.
+     */
+    static bool write(const Scene *scene, const char *file) noexcept;
+    /**
+     * Load the scene from a snapshot. The scene must be empty.
+     * @return true if it succeeds.
+     */
+    static bool load(Scene *scene, const char *file) noexcept;
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !SNAPSHOT_HPP
@@ -0,0 +1,249 @@
+/**
+ * \file sphere_soa.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The spheres stored as structure of arrays for SIMD intersection.
+ */
+
+#include "sphere_soa.hpp"
+
+#include <cfloat>
+
+#if defined(CS6620_SSE2)
+#include <immintrin.h>
+#endif
+
+CS6620_NAMESPACE_BEGIN
+
+SphereSoA::SphereSoA()
+{
+    this->_pad();
+}
+
+SphereSoA::~SphereSoA()
+{
+}
+
+void SphereSoA::clear()
+{
+    this->_x.clear();
+    this->_y.clear();
+    this->_z.clear();
+    this->_radius2.clear();
+    this->_invRadius.clear();
+    this->_size = 0;
+
+    this->_pad();
+}
+
+u32 SphereSoA::add(const vec3 &center, f32 radius)
+{
+    u32 slot = this->_size++;
+
+    this->set(slot, center, radius);
+
+    this->_pad();
+
+    return slot;
+}
+
+void SphereSoA::set(u32 slot, const vec3 &center, f32 radius)
+{
+    assert(slot < this->_size);
+
+    this->_x[slot] = center.x;
+    this->_y[slot] = center.y;
+    this->_z[slot] = center.z;
+    this->_radius2[slot] = radius * radius;
+    this->_invRadius[slot] = 1.0f / radius;
+}
+
+u32 SphereSoA::addEmpty()
+{
+    u32 slot = this->_size++;
+
+    this->_pad();
+
+    return slot;
+}
+
+void SphereSoA::_pad()
+{
+    // The new slots are empty ones that no ray can hit.
+    size_t n = this->_size + WIDTH;
+    this->_x.resize(n, 0.0f);
+    this->_y.resize(n, 0.0f);
+    this->_z.resize(n, 0.0f);
+    this->_radius2.resize(n, -FLT_MAX);
+    this->_invRadius.resize(n, 0.0f);
+}
+
+bool SphereSoA::intersect(const Ray &ray, u32 first, u32 count, f32 &tmax, u32 &out_slot) const noexcept
+{
+    assert(first + count <= this->_size);
+
+    bool hit = false;
+
+#if defined(CS6620_AVX2)
+    const __m256 ox = _mm256_set1_ps(ray.origin.x);
+    const __m256 oy = _mm256_set1_ps(ray.origin.y);
+    const __m256 oz = _mm256_set1_ps(ray.origin.z);
+    const __m256 dx = _mm256_set1_ps(ray.direction.x);
+    const __m256 dy = _mm256_set1_ps(ray.direction.y);
+    const __m256 dz = _mm256_set1_ps(ray.direction.z);
+    const __m256 epsilon = _mm256_set1_ps(RAY_EPSILON);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (u32 i = 0; i < count; i += WIDTH)
+    {
+        u32 slot = first + i;
+
+        // Solve |o + t * d - c|^2 = r^2 for 8 spheres. The discriminant is
+        // r^2 minus the squared distance between the center and the ray.
+        __m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(&this->_x[slot]));
+        __m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(&this->_y[slot]));
+        __m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(&this->_z[slot]));
+
+        __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)), _mm256_mul_ps(ocz, dz));
+        __m256 px = _mm256_sub_ps(ocx, _mm256_mul_ps(dx, b));
+        __m256 py = _mm256_sub_ps(ocy, _mm256_mul_ps(dy, b));
+        __m256 pz = _mm256_sub_ps(ocz, _mm256_mul_ps(dz, b));
+        __m256 distance2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, px), _mm256_mul_ps(py, py)), _mm256_mul_ps(pz, pz));
+
+        __m256 discriminant = _mm256_sub_ps(_mm256_loadu_ps(&this->_radius2[slot]), distance2);
+        __m256 root = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+
+        // Take the near root unless the origin is inside the sphere.
+        __m256 nb = _mm256_sub_ps(zero, b);
+        __m256 t0 = _mm256_sub_ps(nb, root);
+        __m256 t1 = _mm256_add_ps(nb, root);
+        __m256 t = _mm256_blendv_ps(t1, t0, _mm256_cmp_ps(t0, epsilon, _CMP_GT_OQ));
+
+        __m256 mask = _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ);
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, epsilon, _CMP_GT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, _mm256_set1_ps(tmax), _CMP_LT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32((i32)(count - i)), lanes)));
+
+        i32 bits = _mm256_movemask_ps(mask);
+        if (bits == 0)
+        {
+            continue;
+        }
+
+        // Reduce to the nearest lane.
+        f32 distances[WIDTH];
+        _mm256_storeu_ps(distances, t);
+        for (u32 lane = 0; lane < WIDTH; ++lane)
+        {
+            if ((bits & (1 << lane)) != 0 && distances[lane] < tmax)
+            {
+                tmax = distances[lane];
+                out_slot = slot + lane;
+                hit = true;
+            }
+        }
+    }
+#elif defined(CS6620_SSE2)
+    const __m128 ox = _mm_set1_ps(ray.origin.x);
+    const __m128 oy = _mm_set1_ps(ray.origin.y);
+    const __m128 oz = _mm_set1_ps(ray.origin.z);
+    const __m128 dx = _mm_set1_ps(ray.direction.x);
+    const __m128 dy = _mm_set1_ps(ray.direction.y);
+    const __m128 dz = _mm_set1_ps(ray.direction.z);
+    const __m128 epsilon = _mm_set1_ps(RAY_EPSILON);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+
+    for (u32 i = 0; i < count; i += WIDTH)
+    {
+        u32 slot = first + i;
+
+        // Solve |o + t * d - c|^2 = r^2 for 4 spheres. The discriminant is
+        // r^2 minus the squared distance between the center and the ray.
+        __m128 ocx = _mm_sub_ps(ox, _mm_loadu_ps(&this->_x[slot]));
+        __m128 ocy = _mm_sub_ps(oy, _mm_loadu_ps(&this->_y[slot]));
+        __m128 ocz = _mm_sub_ps(oz, _mm_loadu_ps(&this->_z[slot]));
+
+        __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+        __m128 px = _mm_sub_ps(ocx, _mm_mul_ps(dx, b));
+        __m128 py = _mm_sub_ps(ocy, _mm_mul_ps(dy, b));
+        __m128 pz = _mm_sub_ps(ocz, _mm_mul_ps(dz, b));
+        __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)), _mm_mul_ps(pz, pz));
+
+        __m128 discriminant = _mm_sub_ps(_mm_loadu_ps(&this->_radius2[slot]), distance2);
+        __m128 root = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+
+        // Take the near root unless the origin is inside the sphere.
+        __m128 nb = _mm_sub_ps(zero, b);
+        __m128 t0 = _mm_sub_ps(nb, root);
+        __m128 t1 = _mm_add_ps(nb, root);
+        __m128 useNear = _mm_cmpgt_ps(t0, epsilon);
+        __m128 t = _mm_or_ps(_mm_and_ps(useNear, t0), _mm_andnot_ps(useNear, t1));
+
+        __m128 mask = _mm_cmpge_ps(discriminant, zero);
+        mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, epsilon));
+        mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(tmax)));
+        mask = _mm_and_ps(mask, _mm_castsi128_ps(_mm_cmplt_epi32(lanes, _mm_set1_epi32((i32)(count - i)))));
+
+        i32 bits = _mm_movemask_ps(mask);
+        if (bits == 0)
+        {
+            continue;
+        }
+
+        // Reduce to the nearest lane.
+        f32 distances[WIDTH];
+        _mm_storeu_ps(distances, t);
+        for (u32 lane = 0; lane < WIDTH; ++lane)
+        {
+            if ((bits & (1 << lane)) != 0 && distances[lane] < tmax)
+            {
+                tmax = distances[lane];
+                out_slot = slot + lane;
+                hit = true;
+            }
+        }
+    }
+#else
+    for (u32 slot = first; slot < first + count; ++slot)
+    {
+        vec3 oc(ray.origin.x - this->_x[slot], ray.origin.y - this->_y[slot], ray.origin.z - this->_z[slot]);
+        f32 b = oc.Dot(ray.direction);
+        vec3 perpendicular = oc - ray.direction * b;
+
+        f32 discriminant = this->_radius2[slot] - perpendicular.LengthSquared();
+        if (discriminant < 0.0f)
+        {
+            continue;
+        }
+
+        f32 root = cy::Sqrt(discriminant);
+        f32 t = -b - root;
+        if (t <= RAY_EPSILON)
+        {
+            t = -b + root;
+        }
+        if (t > RAY_EPSILON && t < tmax)
+        {
+            tmax = t;
+            out_slot = slot;
+            hit = true;
+        }
+    }
+#endif
+
+    return hit;
+}
+
+void SphereSoA::hit(const Ray &ray, u32 slot, f32 distance, vec3 &out_position, vec3 &out_normal) const noexcept
+{
+    vec3 center(this->_x[slot], this->_y[slot], this->_z[slot]);
+
+    out_position = ray.origin + ray.direction * distance;
+    out_normal = (out_position - center) * this->_invRadius[slot];
+}
+
+CS6620_NAMESPACE_END
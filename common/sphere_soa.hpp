@@ -0,0 +1,107 @@
+/**
+ * \file sphere_soa.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The spheres stored as structure of arrays for SIMD intersection.
+ */
+
+#ifndef SPHERE_SOA_HPP
+#define SPHERE_SOA_HPP
+
+#include "common.h"
+
+#include <vector>
+
+#include "ray.hpp"
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * A set of spheres stored component by component so that one ray can be
+ * tested against WIDTH spheres at once with AVX2 (8) or SSE (4) and falls
+ * back to scalar code elsewhere. A slot can also be left empty, which never
+ * intersects any ray.
+ */
+class SphereSoA
+{
+public:
+#if defined(CS6620_AVX2)
+    static const u32 WIDTH = 8;
+#elif defined(CS6620_SSE2)
+    static const u32 WIDTH = 4;
+#else
+    static const u32 WIDTH = 1;
+#endif
+
+public:
+    /**
+     * Constructor.
+     */
+    explicit SphereSoA();
+    /**
+     * Destructor.
+     */
+    ~SphereSoA();
+    /**
+     * Remove all the spheres.
+     */
+    void clear();
+    /**
+     * Append a sphere.
+     * @return the slot of the sphere.
+     */
+    u32 add(const vec3 &center, f32 radius);
+    /**
+     * Append an empty slot.
+     * @return the slot.
+     */
+    u32 addEmpty();
+    /**
+     * Move a sphere, e.g., when its node is animated.
+     * @param slot the slot of the sphere, which must not be an empty one.
+     */
+    void set(u32 slot, const vec3 &center, f32 radius);
+    /**
+     * Find the nearest sphere in slots [first, first + count) hit by the ray
+     * closer than tmax. Only the distance is computed here so that the
+     * position and normal are computed once for the final hit by hit().
+     * @param ray the ray with a unit length direction.
+     * @param first the first slot.
+     * @param count the number of slots.
+     * @param tmax the nearest hit distance so far. Updated on a closer hit.
+     * @param out_slot return the slot of the closer hit.
+     * @return true if there's a hit closer than tmax.
+     */
+    bool intersect(const Ray &ray, u32 first, u32 count, f32 &tmax, u32 &out_slot) const noexcept;
+    /**
+     * Compute the hit position and normal on a sphere.
+     * @param ray the ray.
+     * @param slot the slot of the hit sphere.
+     * @param distance the hit distance along the ray.
+     */
+    void hit(const Ray &ray, u32 slot, f32 distance, vec3 &out_position, vec3 &out_normal) const noexcept;
+
+    u32 size() const { return this->_size; }
+
+private:
+    /**
+     * Keep WIDTH slots of padding after the last sphere so a vector load
+     * starting at any valid slot stays inside the arrays.
+     */
+    void _pad();
+
+private:
+    std::vector<f32> _x;       /**< The centers. */
+    std::vector<f32> _y;
+    std::vector<f32> _z;
+    std::vector<f32> _radius2; /**< The squared radii. Negative for empty slots. */
+    std::vector<f32> _invRadius;
+    u32 _size = 0;
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !SPHERE_SOA_HPP
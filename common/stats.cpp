@@ -0,0 +1,115 @@
+/**
+ * \file stats.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The ray statistics counters.
+ */
+
+#include "stats.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+CS6620_NAMESPACE_BEGIN
+
+thread_local u64 _statsCounters[Stats::NUM_COUNTERS] = {};
+thread_local bool _statsRegistered = false;
+
+static std::mutex _statsMutex;
+static std::vector<u64 *> _statsThreads;            /**< The counters of the live threads. */
+static u64 _statsRetired[Stats::NUM_COUNTERS] = {}; /**< The counts of the exited threads. */
+
+static const char *COUNTER_NAMES[Stats::NUM_COUNTERS] = {
+    "Primary rays",
+    "Shadow rays",
+    "BVH node visits",
+    "Primitive tests",
+    "Hits",
+};
+
+/**
+ * Moves the counts of the thread to the retired ones when the thread exits.
+ */
+struct StatsThreadExit
+{
+    ~StatsThreadExit()
+    {
+        std::lock_guard<std::mutex> lock(_statsMutex);
+
+        for (u32 i = 0; i < Stats::NUM_COUNTERS; ++i)
+        {
+            _statsRetired[i] += _statsCounters[i];
+        }
+        _statsThreads.erase(std::find(_statsThreads.begin(), _statsThreads.end(), _statsCounters));
+    }
+};
+
+void Stats::_register() noexcept
+{
+    static thread_local StatsThreadExit exit;
+    (void)exit;
+
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    _statsThreads.push_back(_statsCounters);
+    _statsRegistered = true;
+}
+
+void Stats::reset() noexcept
+{
+    std::lock_guard<std::mutex> lock(_statsMutex);
+
+    for (u64 *counters : _statsThreads)
+    {
+        std::fill(counters, counters + NUM_COUNTERS, 0);
+    }
+    std::fill(_statsRetired, _statsRetired + NUM_COUNTERS, 0);
+}
+
+u64 Stats::total(Counter counter) noexcept
+{
+    std::lock_guard<std::mutex> lock(_statsMutex);
+
+    u64 n = _statsRetired[counter];
+    for (u64 *counters : _statsThreads)
+    {
+        n += counters[counter];
+    }
+    return n;
+}
+
+void Stats::report(f64 seconds) noexcept
+{
+#if defined(CS6620_NO_STATS)
+    LOG(INFO) << "Ray statistics are compiled out.";
+#else
+    u64 totals[NUM_COUNTERS];
+    for (u32 i = 0; i < NUM_COUNTERS; ++i)
+    {
+        totals[i] = Stats::total((Counter)i);
+    }
+
+    LOG(INFO) << "Ray statistics:";
+    for (u32 i = 0; i < NUM_COUNTERS; ++i)
+    {
+        LOG(INFO) << "  " << COUNTER_NAMES[i] << ": " << totals[i];
+    }
+
+    u64 rays = totals[PRIMARY_RAYS] + totals[SHADOW_RAYS];
+    if (rays > 0)
+    {
+        LOG(INFO) << "  " << (f64)totals[NODE_VISITS] / (f64)rays << " node visits and "
+            << (f64)totals[PRIMITIVE_TESTS] / (f64)rays << " primitive tests per ray.";
+        LOG(INFO) << "  " << (f64)totals[SHADOW_RAYS] * 100.0 / (f64)rays << "% of the rays are shadow rays"
+            << " taking the any-hit query.";
+    }
+    if (seconds > 0.0)
+    {
+        LOG(INFO) << "  " << (f64)rays / seconds * 1e-6 << " Mrays/s.";
+    }
+#endif
+}
+
+CS6620_NAMESPACE_END
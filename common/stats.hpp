@@ -0,0 +1,88 @@
+/**
+ * \file stats.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The ray statistics counters.
+ */
+
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include "common.h"
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * The ray statistics. Every thread counts into its own counters, which are
+ * merged into the totals of the frame by report(). Define CS6620_NO_STATS
+ * to compile the counting out.
+ */
+class Stats
+{
+public:
+    enum Counter
+    {
+        PRIMARY_RAYS,
+        SHADOW_RAYS,
+        NODE_VISITS,     /**< The BVH nodes tested against a ray. */
+        PRIMITIVE_TESTS, /**< The primitives tested against a ray. */
+        HITS,            /**< The rays that hit anything. */
+
+        NUM_COUNTERS,
+    };
+
+public:
+    /**
+     * Add to a counter of the calling thread.
+     */
+    static void add(Counter counter, u64 n = 1);
+    /**
+     * Zero the counters of all threads at the start of a frame.
+     */
+    static void reset() noexcept;
+    /**
+     * Merge the counters of all threads and log them with the ray rate.
+     * Must not be called while other threads are counting.
+     * @param seconds the time of the frame.
+     */
+    static void report(f64 seconds) noexcept;
+    /**
+     * The merged value of a counter.
+     */
+    static u64 total(Counter counter) noexcept;
+
+private:
+    /**
+     * Make the calling thread's counters known to the report.
+     */
+    static void _register() noexcept;
+};
+
+/**
+ * The counters of a thread. They're plain data so that the access needs no
+ * initialization check.
+ */
+extern thread_local u64 _statsCounters[Stats::NUM_COUNTERS];
+extern thread_local bool _statsRegistered;
+
+inline void Stats::add(Counter counter, u64 n)
+{
+    if (!_statsRegistered)
+    {
+        Stats::_register();
+    }
+    _statsCounters[counter] += n;
+}
+
+CS6620_NAMESPACE_END
+
+#if defined(CS6620_NO_STATS)
+#define CS6620_STATS_ADD(counter, n)
+#else
+#define CS6620_STATS_ADD(counter, n) cs6620::Stats::add(cs6620::Stats::counter, n)
+#endif
+
+
+#endif // !STATS_HPP
@@ -0,0 +1,151 @@
+/**
+ * \file thread_pool.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * A pool of worker threads that run batches of tasks with work stealing.
+ */
+
+#include "thread_pool.hpp"
+
+CS6620_NAMESPACE_BEGIN
+
+ThreadPool::ThreadPool(u32 numThreads)
+    : _remaining(0)
+{
+    if (numThreads == 0)
+    {
+        numThreads = cy::Max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    for (u32 i = 0; i < numThreads; ++i)
+    {
+        this->_queues.push_back(new Queue());
+    }
+    for (u32 i = 0; i < numThreads; ++i)
+    {
+        this->_workers.push_back(std::thread(&ThreadPool::_work, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_exit = true;
+    }
+    this->_wakeup.notify_all();
+
+    for (auto &&worker : this->_workers)
+    {
+        worker.join();
+    }
+    for (auto &&queue : this->_queues)
+    {
+        delete queue;
+    }
+}
+
+void ThreadPool::run(u32 numTasks, const Job &job) noexcept
+{
+    if (numTasks == 0)
+    {
+        return;
+    }
+
+    u32 numThreads = this->size();
+
+    std::unique_lock<std::mutex> lock(this->_mutex);
+
+    this->_job = &job;
+    this->_remaining = numTasks;
+
+    // Deal the tasks out in contiguous blocks.
+    for (u32 i = 0; i < numThreads; ++i)
+    {
+        u32 begin = (u32)((u64)numTasks * i / numThreads);
+        u32 end = (u32)((u64)numTasks * (i + 1) / numThreads);
+
+        std::lock_guard<std::mutex> queueLock(this->_queues[i]->mutex);
+        for (u32 task = begin; task < end; ++task)
+        {
+            this->_queues[i]->tasks.push_back(task);
+        }
+    }
+
+    this->_batch++;
+    this->_wakeup.notify_all();
+
+    this->_finished.wait(lock, [this]() { return this->_remaining.load() == 0; });
+
+    this->_job = nullptr;
+}
+
+void ThreadPool::_work(u32 thread) noexcept
+{
+    u64 seenBatch = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->_mutex);
+            this->_wakeup.wait(lock, [this, seenBatch]() { return this->_exit || this->_batch != seenBatch; });
+
+            if (this->_exit)
+            {
+                return;
+            }
+            seenBatch = this->_batch;
+        }
+
+        u32 task;
+        while (this->_take(thread, task))
+        {
+            (*this->_job)(task, thread);
+
+            if (this->_remaining.fetch_sub(1) == 1)
+            {
+                // The last task of the batch. Take the lock so the caller
+                // can't miss the notification between its check and wait.
+                {
+                    std::lock_guard<std::mutex> lock(this->_mutex);
+                }
+                this->_finished.notify_all();
+            }
+        }
+    }
+}
+
+bool ThreadPool::_take(u32 thread, u32 &out_task) noexcept
+{
+    // The own queue first, from the back.
+    {
+        Queue *queue = this->_queues[thread];
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (!queue->tasks.empty())
+        {
+            out_task = queue->tasks.back();
+            queue->tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Steal from the front of the others, starting from the neighbour.
+    u32 numThreads = this->size();
+    for (u32 i = 1; i < numThreads; ++i)
+    {
+        Queue *victim = this->_queues[(thread + i) % numThreads];
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (!victim->tasks.empty())
+        {
+            out_task = victim->tasks.front();
+            victim->tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+CS6620_NAMESPACE_END
@@ -0,0 +1,87 @@
+/**
+ * \file thread_pool.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * A pool of worker threads that run batches of tasks with work stealing.
+ */
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include "common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * Each worker owns a deque of task indices. It pops its own tasks from the
+ * back and, once it runs dry, steals from the front of the other workers'
+ * deques. The tasks of a batch are dealt out in contiguous blocks so that a
+ * worker normally processes neighbouring tasks.
+ */
+class ThreadPool
+{
+public:
+    typedef std::function<void(u32 task, u32 thread)> Job;
+
+public:
+    /**
+     * Constructor.
+     * @param numThreads the number of worker threads. 0 means one per
+     * hardware thread.
+     */
+    explicit ThreadPool(u32 numThreads = 0);
+    /**
+     * Destructor. Join all workers.
+     */
+    ~ThreadPool();
+    /**
+     * Run job(task, thread) for every task in [0, numTasks) and wait until
+     * all of them are finished. Must not be called from inside a job.
+     */
+    void run(u32 numTasks, const Job &job) noexcept;
+    /**
+     * The number of worker threads.
+     */
+    u32 size() const { return (u32)this->_queues.size(); }
+
+private:
+    struct Queue
+    {
+        std::mutex      mutex;
+        std::deque<u32> tasks;
+    };
+
+    void _work(u32 thread) noexcept;
+    /**
+     * Take a task from the thread's own queue or steal one from the others.
+     */
+    bool _take(u32 thread, u32 &out_task) noexcept;
+
+private:
+    std::vector<std::thread> _workers;
+    std::vector<Queue *>     _queues;
+
+    std::mutex              _mutex;
+    std::condition_variable _wakeup;     /**< Signals workers a new batch or exit. */
+    std::condition_variable _finished;   /**< Signals the caller the batch is done. */
+    u64                     _batch = 0;  /**< The id of the current batch. */
+    bool                    _exit = false;
+
+    const Job        *_job = nullptr;
+    std::atomic<u32>  _remaining;        /**< Tasks not yet finished in this batch. */
+};
+
+CS6620_NAMESPACE_END
+
+
+#endif // !THREAD_POOL_HPP
@@ -0,0 +1,240 @@
+/**
+ * \file tonemap.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * Map the linear HDR colors to 8-bit display colors.
+ */
+
+#include "tonemap.hpp"
+
+#include "thread_pool.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(CS6620_SSE2)
+#include <immintrin.h>
+#endif
+
+CS6620_NAMESPACE_BEGIN
+
+static const u32 LUT_SIZE = 4096;  /**< The entries of the encoding tables over [0, 1]. */
+static const u32 ROWS_PER_TASK = 16;
+
+/**
+ * The tables from a value in [0, 1] quantized to LUT_SIZE steps to its 8-bit
+ * code. The entries are 32-bit for the AVX2 gather.
+ */
+struct EncodingTables
+{
+    u32 srgb[LUT_SIZE];
+    u32 linear[LUT_SIZE];
+
+    EncodingTables()
+    {
+        for (u32 i = 0; i < LUT_SIZE; ++i)
+        {
+            f32 x = (f32)i / (f32)(LUT_SIZE - 1);
+            f32 s = x <= 0.0031308f ? 12.92f * x : 1.055f * powf(x, 1.0f / 2.4f) - 0.055f;
+            this->srgb[i] = (u32)(s * 255.0f + 0.5f);
+            this->linear[i] = (u32)(x * 255.0f + 0.5f);
+        }
+    }
+};
+
+static const EncodingTables &_GetEncodingTables()
+{
+    static EncodingTables tables;
+    return tables;
+}
+
+/**
+ * The tone curve of a non-negative value. +Inf may turn into NaN, which the
+ * clamping afterwards takes as 1.
+ */
+template <ToneOperator OP>
+static inline f32 _Tone(f32 x)
+{
+    if (OP == ToneOperator::REINHARD)
+    {
+        return x / (1.0f + x);
+    }
+    if (OP == ToneOperator::ACES)
+    {
+        // The fit takes the exposure of the original curve as 0.6.
+        x *= 0.6f;
+        return (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+    }
+    return x;
+}
+
+#if defined(CS6620_SSE2)
+template <ToneOperator OP>
+static inline __m128 _Tone(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    if (OP == ToneOperator::REINHARD)
+    {
+        return _mm_div_ps(x, _mm_add_ps(one, x));
+    }
+    if (OP == ToneOperator::ACES)
+    {
+        x = _mm_mul_ps(x, _mm_set1_ps(0.6f));
+        __m128 a = _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), x), _mm_set1_ps(0.03f)));
+        __m128 b = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), x), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f));
+        return _mm_div_ps(a, b);
+    }
+    return x;
+}
+#endif
+
+#if defined(CS6620_AVX2)
+template <ToneOperator OP>
+static inline __m256 _Tone(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    if (OP == ToneOperator::REINHARD)
+    {
+        return _mm256_div_ps(x, _mm256_add_ps(one, x));
+    }
+    if (OP == ToneOperator::ACES)
+    {
+        x = _mm256_mul_ps(x, _mm256_set1_ps(0.6f));
+        __m256 a = _mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.51f), x), _mm256_set1_ps(0.03f)));
+        __m256 b = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.43f), x), _mm256_set1_ps(0.59f))), _mm256_set1_ps(0.14f));
+        return _mm256_div_ps(a, b);
+    }
+    return x;
+}
+#endif
+
+/**
+ * Convert n values. The channels go through the same curve, so the pixels
+ * are just a flat array here.
+ */
+template <ToneOperator OP>
+static void _Convert(const f32 *src, u8 *dst, size_t n, f32 exposure, const u32 *table)
+{
+    const f32 scale = (f32)(LUT_SIZE - 1);
+
+    size_t i = 0;
+
+#if defined(CS6620_AVX2)
+    const __m256 exposure8 = _mm256_set1_ps(exposure);
+    const __m256 zero8 = _mm256_setzero_ps();
+    const __m256 one8 = _mm256_set1_ps(1.0f);
+    const __m256 scale8 = _mm256_set1_ps(scale);
+    const __m256 half8 = _mm256_set1_ps(0.5f);
+    for (; i + 8 <= n; i += 8)
+    {
+        // max() and min() return their second operand for NaN, so NaN
+        // turns into 0 before the curve and into 1 after it.
+        __m256 x = _mm256_mul_ps(_mm256_loadu_ps(src + i), exposure8);
+        x = _mm256_max_ps(x, zero8);
+        x = _Tone<OP>(x);
+        x = _mm256_min_ps(x, one8);
+
+        __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(x, scale8), half8));
+        __m256i code = _mm256_i32gather_epi32((const int *)table, index, 4);
+
+        __m128i code16 = _mm_packus_epi32(_mm256_castsi256_si128(code), _mm256_extracti128_si256(code, 1));
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(code16, code16));
+    }
+#elif defined(CS6620_SSE2)
+    const __m128 exposure4 = _mm_set1_ps(exposure);
+    const __m128 zero4 = _mm_setzero_ps();
+    const __m128 one4 = _mm_set1_ps(1.0f);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    const __m128 half4 = _mm_set1_ps(0.5f);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 x = _mm_mul_ps(_mm_loadu_ps(src + i), exposure4);
+        x = _mm_max_ps(x, zero4);
+        x = _Tone<OP>(x);
+        x = _mm_min_ps(x, one4);
+
+        alignas(16) i32 index[4];
+        _mm_store_si128((__m128i *)index, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, scale4), half4)));
+        dst[i + 0] = (u8)table[index[0]];
+        dst[i + 1] = (u8)table[index[1]];
+        dst[i + 2] = (u8)table[index[2]];
+        dst[i + 3] = (u8)table[index[3]];
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        // Written so that NaN fails both comparisons as in the SIMD code.
+        f32 x = src[i] * exposure;
+        x = x > 0.0f ? x : 0.0f;
+        x = _Tone<OP>(x);
+        x = x < 1.0f ? x : 1.0f;
+        dst[i] = (u8)table[(u32)(x * scale + 0.5f)];
+    }
+}
+
+bool ParseToneOperator(const char *name, ToneOperator &out_op)
+{
+    if (strcmp(name, "clamp") == 0)
+    {
+        out_op = ToneOperator::CLAMP;
+    }
+    else if (strcmp(name, "reinhard") == 0)
+    {
+        out_op = ToneOperator::REINHARD;
+    }
+    else if (strcmp(name, "aces") == 0)
+    {
+        out_op = ToneOperator::ACES;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void CvtRgb32f2Rgb8(const f32 *rgb32f, u32 width, u32 height, u8 *rgb8, const ToneMapping &toneMapping, ThreadPool *pool)
+{
+    const EncodingTables &tables = _GetEncodingTables();
+    const u32 *table = toneMapping.srgb ? tables.srgb : tables.linear;
+
+    void (*convert)(const f32 *, u8 *, size_t, f32, const u32 *) = nullptr;
+    switch (toneMapping.op)
+    {
+    case ToneOperator::REINHARD:
+        convert = &_Convert<ToneOperator::REINHARD>;
+        break;
+    case ToneOperator::ACES:
+        convert = &_Convert<ToneOperator::ACES>;
+        break;
+    default:
+        convert = &_Convert<ToneOperator::CLAMP>;
+        break;
+    }
+
+    size_t rowSize = (size_t)width * 3;
+    u32 numTasks = (height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    auto job = [&](u32 task, u32)
+    {
+        u32 y0 = task * ROWS_PER_TASK;
+        u32 y1 = cy::Min(y0 + ROWS_PER_TASK, height);
+        convert(rgb32f + y0 * rowSize, rgb8 + y0 * rowSize, (y1 - y0) * rowSize, toneMapping.exposure, table);
+    };
+
+    if (pool != nullptr && numTasks > 1)
+    {
+        pool->run(numTasks, job);
+    }
+    else
+    {
+        for (u32 task = 0; task < numTasks; ++task)
+        {
+            job(task, 0);
+        }
+    }
+}
+
+CS6620_NAMESPACE_END
@@ -0,0 +1,61 @@
+/**
+ * \file tonemap.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * Map the linear HDR colors to 8-bit display colors.
+ */
+
+#ifndef TONEMAP_HPP
+#define TONEMAP_HPP
+
+#include "common.h"
+
+CS6620_NAMESPACE_BEGIN
+
+class ThreadPool;
+
+enum class ToneOperator
+{
+    CLAMP,    /**< Clip to [0, 1]. */
+    REINHARD, /**< x / (1 + x) per channel. */
+    ACES,     /**< Narkowicz's fit of the ACES filmic curve. */
+};
+
+/**
+ * How the linear colors become display colors: scaled by the exposure,
+ * compressed by the tone operator, clamped to [0, 1] and encoded with the
+ * sRGB transfer curve or linearly. Negative and NaN values end up black and
+ * +Inf white.
+ */
+struct ToneMapping
+{
+    ToneOperator op = ToneOperator::CLAMP;
+    f32          exposure = 1.0f;
+    bool         srgb = true;
+};
+
+/**
+ * Parse the name of a tone operator, i.e., "clamp", "reinhard" or "aces".
+ * @return true if the name is known.
+ */
+extern bool ParseToneOperator(const char *name, ToneOperator &out_op);
+
+/**
+ * Convert a linear RGB float image into RGB8, with AVX2 or SSE2 where
+ * available.
+ * @param rgb32f the source pixels.
+ * @param width, height the image size.
+ * @param rgb8 the destination pixels.
+ * @param toneMapping the conversion.
+ * @param pool the threads to split the rows among. nullptr runs on the
+ * calling thread.
+ */
+extern void CvtRgb32f2Rgb8(const f32 *rgb32f, u32 width, u32 height, u8 *rgb8,
+    const ToneMapping &toneMapping = ToneMapping(), ThreadPool *pool = nullptr);
+
+CS6620_NAMESPACE_END
+
+
+#endif // !TONEMAP_HPP
@@ -12,8 +12,10 @@
 
 #include "scene_node.hpp"
 #include "scene.hpp"
+#include "stats.hpp"
 
 #include <list>
+#include <cfloat>
 
 CS6620_NAMESPACE_BEGIN
 
@@ -30,7 +32,10 @@ Tree::Tree(Scene *scene)
 
         nodes.insert(nodes.end(), node->children.begin(), node->children.end());
 
-        this->_nodes.push_back(node);
+        if (node->type == SceneNode::Type::GEOMETRY)
+        {
+            this->_nodes.push_back(static_cast<GeometricNode *>(node));
+        }
     }
 }
     
@@ -38,18 +43,53 @@ Tree::~Tree()
 {
 }
 
-bool Tree::intersect(const Ray &ray, SceneNode *out_node, vec3 &out_position, vec3 &out_normal) noexcept
+bool Tree::intersect(const Ray &ray, SceneNode *&out_node, vec3 &out_position, vec3 &out_normal) const noexcept
 {
+    // Every node only reports a hit closer than the previous ones, so the
+    // last reported one is the nearest.
+    f32 distance = FLT_MAX;
+    bool hit = false;
+
+    CS6620_STATS_ADD(PRIMITIVE_TESTS, this->_nodes.size());
+
     for (auto &&node : this->_nodes)
     {
-        GeometricNode *gnode = reinterpret_cast<GeometricNode *>(node);
-        if (gnode->intersect(ray, out_position, out_normal))
+        if (node->intersect(ray, distance, out_position, out_normal))
         {
             out_node = node;
-            return true;
+            hit = true;
         }
     }
 
+    return hit;
+}
+
+bool Tree::occluded(const Ray &ray, f32 tmax) const noexcept
+{
+    vec3 position;
+    vec3 normal;
+    u32 tests = 0;
+    bool hit = false;
+
+    for (auto &&node : this->_nodes)
+    {
+        ++tests;
+
+        f32 distance = tmax;
+        if (node->intersect(ray, distance, position, normal))
+        {
+            hit = true;
+            break;
+        }
+    }
+
+    CS6620_STATS_ADD(PRIMITIVE_TESTS, tests);
+
+    return hit;
+}
+
+bool Tree::update(f32, ThreadPool *) noexcept
+{
     return false;
 }
 
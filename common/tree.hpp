@@ -19,7 +19,9 @@ CS6620_NAMESPACE_BEGIN
 
 class Scene;
 class SceneNode;
+class GeometricNode;
 class Ray;
+class ThreadPool;
 
 
 class Tree
@@ -41,10 +43,28 @@ public:
      * @param out_normal return the normal at the intersection point.
      * @return return true if the ray intersection happens.
      */
-    bool intersect(const Ray &ray, SceneNode *out_node, vec3 &out_position, vec3 &out_normal) noexcept;
+    virtual bool intersect(const Ray &ray, SceneNode *&out_node, vec3 &out_position, vec3 &out_normal) const noexcept;
+    /**
+     * If anything is hit by the ray closer than tmax, e.g., between a point
+     * and a light for a shadow ray. It stops at the first hit found and
+     * computes neither the position nor the normal.
+     * @param ray the ray in world space.
+     * @param tmax the distance along the ray to look up to.
+     * @return true if the ray is blocked.
+     */
+    virtual bool occluded(const Ray &ray, f32 tmax) const noexcept;
+    /**
+     * Bring the structure up to date after the nodes moved. The naive one
+     * reads the nodes directly and has nothing to do.
+     * @param rebuildThreshold how many times worse the structure may get
+     * than the one built before it's rebuilt rather than refit.
+     * @param pool the threads to rebuild with, or nullptr.
+     * @return true if it was rebuilt.
+     */
+    virtual bool update(f32 rebuildThreshold, ThreadPool *pool) noexcept;
 
-private:
-    std::vector<SceneNode *> _nodes; /**< The nodes of the scene in a flat array .*/
+protected:
+    std::vector<GeometricNode *> _nodes; /**< The geometric nodes of the scene in a flat array .*/
 };
 
 CS6620_NAMESPACE_END
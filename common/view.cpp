@@ -9,57 +9,222 @@
 
 #include "view.hpp"
 
-#include "ppm.h"
+#include "hdr_writer.hpp"
+#include "profiler.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <vector>
 
 CS6620_NAMESPACE_BEGIN
 
-View::View(u32 width, u32 height)
+/**
+ * The relative luminance of a linear Rec. 709 color.
+ */
+static inline f64 _Luminance(f64 r, f64 g, f64 b)
+{
+    return 0.2126 * r + 0.7152 * g + 0.0722 * b;
+}
+
+View::View(u32 width, u32 height, u32 windowHeight)
 {
     assert(width > 0 && height > 0);
 
     this->_width = width;
     this->_height = height;
+    this->_windowHeight = windowHeight > 0 ? cy::Min(windowHeight, height) : height;
 
-    this->_image = new f32 [width * height * 3];
+    size_t n = (size_t)width * this->_windowHeight;
+    this->_image = new f32 [n * 3];
+    this->_accumulation = new f64 [n * 3];
+    this->_luminance2 = new f64 [n];
+    this->_sampleCounts = new u32 [n];
+
+    this->clear();
 }
     
 View::~View()
 {
     delete [] this->_image;
+    delete [] this->_accumulation;
+    delete [] this->_luminance2;
+    delete [] this->_sampleCounts;
 }
 
 bool View::dump(const char *outputFilePath) const noexcept 
 {
-    u8 *imageRGB8 = new u8 [this->_width * this->_height * 3];
-    CvtRgb32f2Rgb8(this->_image, this->_width, this->_height, imageRGB8);
-    bool ret = WritePPM(outputFilePath, this->_width, this->_height, imageRGB8);
-    delete [] imageRGB8;
-    return ret;
+    CS6620_PROFILE_SCOPE("View dump");
+
+    if (!this->_checkWhole())
+    {
+        return false;
+    }
+
+    // A preview of the same file may still be on its way.
+    bool ret = this->_writer.wait();
+
+    if (IsHDRFile(outputFilePath))
+    {
+        return WriteHDR(outputFilePath, this->_width, this->_height, this->_image, this->_pool) && ret;
+    }
+
+    std::vector<u8> imageRGB8(this->_width * this->_height * 3);
+    CvtRgb32f2Rgb8(this->_image, this->_width, this->_height, imageRGB8.data(), this->_toneMapping, this->_pool);
+    return this->_writer.write(outputFilePath, this->_width, this->_height, imageRGB8.data(), this->_finalCompression) && ret;
+}
+
+void View::dumpAsync(const char *outputFilePath) noexcept
+{
+    CS6620_PROFILE_SCOPE("View dump");
+
+    if (!this->_checkWhole())
+    {
+        return;
+    }
+
+    // The float images are written as they are, with no 8-bit copy to hand
+    // over to the background thread.
+    if (IsHDRFile(outputFilePath))
+    {
+        this->_writer.wait();
+        WriteHDR(outputFilePath, this->_width, this->_height, this->_image, this->_pool);
+        return;
+    }
+
+    std::vector<u8> imageRGB8(this->_width * this->_height * 3);
+    CvtRgb32f2Rgb8(this->_image, this->_width, this->_height, imageRGB8.data(), this->_toneMapping, this->_pool);
+    this->_writer.writeAsync(outputFilePath, this->_width, this->_height, std::move(imageRGB8), this->_previewCompression);
+}
+
+void View::setPNGCompression(PNGCompression preview, PNGCompression final)
+{
+    this->_previewCompression = preview;
+    this->_finalCompression = final;
 }
     
 void View::write(const vec2u coordinate, const vec3 &color)
 {
-    u32 offset = (coordinate.y * this->_width + coordinate.x) * 3;
-    f32 *p = &this->_image[offset];
+    f32 *p = &this->_image[this->_index(coordinate) * 3];
     p[0] = color.x;
     p[1] = color.y;
     p[2] = color.z;
 }
 
-void CvtRgb32f2Rgb8(const float *rgb32f, u32 width, u32 height, u8 *rgb8)
+void View::clear()
+{
+    u32 n = this->_width * this->_windowHeight;
+    std::fill(this->_accumulation, this->_accumulation + n * 3, 0.0);
+    std::fill(this->_luminance2, this->_luminance2 + n, 0.0);
+    std::fill(this->_sampleCounts, this->_sampleCounts + n, 0u);
+}
+
+void View::accumulate(const vec2u coordinate, const vec3 &color)
+{
+    u32 index = this->_index(coordinate);
+
+    f64 *sum = &this->_accumulation[index * 3];
+    sum[0] += color.x;
+    sum[1] += color.y;
+    sum[2] += color.z;
+
+    f64 luminance = _Luminance(color.x, color.y, color.z);
+    this->_luminance2[index] += luminance * luminance;
+
+    u32 count = ++this->_sampleCounts[index];
+
+    f64 inv = 1.0 / (f64)count;
+    f32 *p = &this->_image[index * 3];
+    p[0] = (f32)(sum[0] * inv);
+    p[1] = (f32)(sum[1] * inv);
+    p[2] = (f32)(sum[2] * inv);
+}
+
+f32 View::error(const vec2u coordinate) const
 {
-    for (u32 i = 0; i < height; i++)
-    for (u32 j = 0; j < width; j++)
+    u32 index = this->_index(coordinate);
+
+    u32 n = this->_sampleCounts[index];
+    if (n < 2)
     {
-        const float *src = &rgb32f[(i * width + j) * 3];
-        u8 *dst = &rgb8[(i * width + j) * 3];
+        return FLT_MAX;
+    }
+
+    const f64 *sum = &this->_accumulation[index * 3];
+    f64 mean = _Luminance(sum[0], sum[1], sum[2]) / (f64)n;
+
+    // The unbiased sample variance, divided by n once more for the variance
+    // of the mean.
+    f64 variance = (this->_luminance2[index] - mean * mean * (f64)n) / (f64)(n - 1);
+
+    return (f32)sqrt(std::max(variance, 0.0) / (f64)n);
+}
+
+bool View::dumpSampleCounts(const char *outputFilePath) const noexcept
+{
+    CS6620_PROFILE_SCOPE("View dump");
 
-        dst[0] = (u8)(src[0] * 255.0f);
-        dst[1] = (u8)(src[1] * 255.0f);
-        dst[2] = (u8)(src[2] * 255.0f);
-     }
+    if (!this->_checkWhole())
+    {
+        return false;
+    }
+
+    u32 n = this->_width * this->_height;
+
+    u32 minCount = *std::min_element(this->_sampleCounts, this->_sampleCounts + n);
+    u32 maxCount = *std::max_element(this->_sampleCounts, this->_sampleCounts + n);
+    f32 scale = maxCount > minCount ? 1.0f / (f32)(maxCount - minCount) : 0.0f;
+
+    u8 *imageRGB8 = new u8 [n * 3];
+    for (u32 i = 0; i < n; ++i)
+    {
+        // Blue, green and red at the low, middle and high end of the range.
+        f32 t = (f32)(this->_sampleCounts[i] - minCount) * scale;
+        imageRGB8[i * 3 + 0] = (u8)(cy::Max(2.0f * t - 1.0f, 0.0f) * 255.0f);
+        imageRGB8[i * 3 + 1] = (u8)((1.0f - fabsf(2.0f * t - 1.0f)) * 255.0f);
+        imageRGB8[i * 3 + 2] = (u8)(cy::Max(1.0f - 2.0f * t, 0.0f) * 255.0f);
+    }
+
+    bool ret = this->_writer.write(outputFilePath, this->_width, this->_height, imageRGB8, this->_finalCompression);
+    delete [] imageRGB8;
+    return ret;
+}
+
+void View::moveWindow(u32 y)
+{
+    assert(y < this->_height);
+
+    this->_windowY = y;
+    this->clear();
+}
+
+bool View::beginStream(const char *outputFilePath) noexcept
+{
+    return this->_writer.beginStream(outputFilePath, this->_width, this->_height);
+}
+
+void View::streamWindow() noexcept
+{
+    CS6620_PROFILE_SCOPE("View dump");
+
+    // The last window may run past the bottom of the image.
+    u32 rows = cy::Min(this->_windowHeight, this->_height - this->_windowY);
+
+    std::vector<u8> rowsRGB8((size_t)this->_width * rows * 3);
+    CvtRgb32f2Rgb8(this->_image, this->_width, rows, rowsRGB8.data(), this->_toneMapping, this->_pool);
+    this->_writer.appendAsync(std::move(rowsRGB8));
+}
+
+bool View::_checkWhole() const
+{
+    if (this->_windowHeight < this->_height)
+    {
+        LOG(ERROR) << "The view holds " << this->_windowHeight << " of " << this->_height
+            << " rows and can only be streamed.";
+        return false;
+    }
+    return true;
 }
 
 CS6620_NAMESPACE_END
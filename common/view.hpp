@@ -12,38 +12,162 @@
 
 #include "common.h"
 
+#include "tonemap.hpp"
+#include "image_writer.hpp"
+
+#include <cassert>
+
 CS6620_NAMESPACE_BEGIN
 
+class ThreadPool;
+
 /**
  * The preview window of the rendering result.
+ *
+ * A view may hold only a window of rows of the image, so a huge frame never
+ * sits in memory at once. The window moves down the image and each band of
+ * rows is streamed to the output file once it's rendered. The pixels are
+ * still addressed by their coordinates in the whole image.
  */
 class View
 {
 public:
     /**
+     * @param windowHeight the rows held in memory. 0 means the whole image.
      */
-    explicit View(u32 width, u32 height);
+    explicit View(u32 width, u32 height, u32 windowHeight = 0);
     /**
      */
     ~View();
     /**
-     * Dump the current result in memory to the disk.
+     * Dump the current result in memory to the disk, tone mapped to 8 bits.
+     * The format follows the extension, i.e., .png or otherwise .ppm, or
+     * .pfm and .exr for the linear colors without the tone mapping. The
+     * pending asynchronous dumps are finished first.
+     * @return true if it and the pending dumps succeed.
      */
     bool dump(const char *outputFilePath) const noexcept;
+    /**
+     * Dump the current result as a preview and return once it's tone mapped,
+     * leaving the encoding and the writing to a background thread. The
+     * .pfm and .exr files are written right away.
+     */
+    void dumpAsync(const char *outputFilePath) noexcept;
+    /**
+     * Wait for the asynchronous dumps.
+     * @return true if all of them succeeded.
+     */
+    bool flush() noexcept { return this->_writer.wait(); }
+    /**
+     * Set the PNG compression of the previews by dumpAsync() and of the
+     * final images by dump().
+     */
+    void setPNGCompression(PNGCompression preview, PNGCompression final);
+    /**
+     * Set how the colors are mapped to 8 bits when dumped.
+     */
+    void setToneMapping(const ToneMapping &toneMapping) { this->_toneMapping = toneMapping; }
+    /**
+     * Set the threads to convert the image with when dumped, or nullptr to
+     * convert on the calling thread.
+     */
+    void setThreadPool(ThreadPool *pool) { this->_pool = pool; }
     /**
      * Write the color to the memory in specific coordinate.
      * @param coordinate The image pixel coordinate.
      * @param color The color value in floating RGBA format.
      */
     void write(const vec2u coordinate, const vec3 &color);
+    /**
+     * Reset the accumulation of the progressive rendering.
+     */
+    void clear();
+    /**
+     * Add a sample to a pixel in the progressive rendering and update its
+     * color to the average of all samples so far.
+     * @param coordinate The image pixel coordinate.
+     * @param color The color of the new sample.
+     */
+    void accumulate(const vec2u coordinate, const vec3 &color);
+    /**
+     * The number of samples accumulated in a pixel.
+     */
+    u32 samples(const vec2u coordinate) const { return this->_sampleCounts[this->_index(coordinate)]; }
+    /**
+     * The standard error of the mean luminance of a pixel estimated from
+     * the samples accumulated so far. FLT_MAX if there are less than two.
+     */
+    f32 error(const vec2u coordinate) const;
+    /**
+     * Dump the sample count of each pixel as a heatmap, going from blue for
+     * the fewest samples to red for the most.
+     */
+    bool dumpSampleCounts(const char *outputFilePath) const noexcept;
+    /**
+     * Move the window to start at a row and clear it.
+     */
+    void moveWindow(u32 y);
+    /**
+     * Start streaming the image to a .ppm file, one window at a time.
+     * @return true if the file is created.
+     */
+    bool beginStream(const char *outputFilePath) noexcept;
+    /**
+     * Tone map the rows in the window and queue them to append to the
+     * streamed file in the background. The windows must be streamed in
+     * order from the top, and the window may be moved on right away.
+     */
+    void streamWindow() noexcept;
+    /**
+     * Wait for the streamed rows and close the file.
+     * @return true if all rows of the image are written.
+     */
+    bool endStream() noexcept { return this->_writer.endStream(); }
+
+    u32 width() const { return this->_width; }
+
+    u32 height() const { return this->_height; }
+    /**
+     * The first row in the window.
+     */
+    u32 windowY() const { return this->_windowY; }
+    /**
+     * The rows the window holds, the image height unless streaming.
+     */
+    u32 windowHeight() const { return this->_windowHeight; }
+
+private:
+    /**
+     * The index of a pixel in the window.
+     */
+    u32 _index(const vec2u coordinate) const
+    {
+        assert(coordinate.y >= this->_windowY && coordinate.y - this->_windowY < this->_windowHeight);
+        return (coordinate.y - this->_windowY) * this->_width + coordinate.x;
+    }
+    /**
+     * If the whole image is in memory, or log an error.
+     */
+    bool _checkWhole() const;
 
 private:
-    f32 *_image = nullptr; /**< The image in memory (width x height x rgb). TODO: resolved? */
+    f32 *_image = nullptr; /**< The rows in the window (width x windowHeight x rgb). */
     u32 _width;
     u32 _height;
-};
+    u32 _windowY = 0;
+    u32 _windowHeight;
 
-extern void CvtRgb32f2Rgb8(const float *rgba32f, u32 width, u32 height, u8 *rgb8);
+    f64 *_accumulation = nullptr; /**< The sum of the samples of each pixel (width x windowHeight x rgb). */
+    f64 *_luminance2 = nullptr;   /**< The sum of the squared luminance of the samples of each pixel. */
+    u32 *_sampleCounts = nullptr; /**< The number of the samples of each pixel. */
+
+    ToneMapping _toneMapping;
+    ThreadPool *_pool = nullptr;
+
+    mutable ImageWriter _writer;
+    PNGCompression      _previewCompression = PNGCompression::FAST;
+    PNGCompression      _finalCompression = PNGCompression::BEST;
+};
 
 CS6620_NAMESPACE_END
 
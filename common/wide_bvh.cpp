@@ -0,0 +1,119 @@
+/**
+ * \file wide_bvh.cpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The 4 or 8-ary BVH collapsed from a binary one.
+ */
+
+#include "wide_bvh.hpp"
+
+#include "profiler.hpp"
+
+#include <cfloat>
+
+CS6620_NAMESPACE_BEGIN
+
+template <int N>
+WideBVH<N>::WideBVH()
+{
+}
+
+template <int N>
+WideBVH<N>::~WideBVH()
+{
+}
+
+template <int N>
+void WideBVH<N>::build(const BVH &bvh) noexcept
+{
+    CS6620_PROFILE_SCOPE("Wide BVH build");
+
+    this->_nodes.clear();
+    if (bvh.numNodes() == 0)
+    {
+        return;
+    }
+
+    // Every wide node takes at least two binary interior nodes but the root.
+    this->_nodes.reserve(bvh.numNodes() / 2 + 1);
+    this->_collapse(bvh.nodes(), 0);
+    this->_nodes.shrink_to_fit();
+}
+
+template <int N>
+u32 WideBVH<N>::_collapse(const BVHNode *nodes, u32 binaryNode) noexcept
+{
+    u32 nodeIndex = (u32)this->_nodes.size();
+    this->_nodes.push_back(WideBVHNode<N>());
+
+    // Start with the children of the binary node, or the node itself if
+    // it's a single leaf, and keep opening the largest interior child.
+    u32 children[N];
+    u32 numChildren = 0;
+    const BVHNode &binary = nodes[binaryNode];
+    if (binary.leaf())
+    {
+        children[numChildren++] = binaryNode;
+    }
+    else
+    {
+        children[numChildren++] = binaryNode + 1;
+        children[numChildren++] = binary.offset;
+    }
+
+    while (numChildren < N)
+    {
+        i32 largest = -1;
+        f32 largestArea = -FLT_MAX;
+        for (u32 i = 0; i < numChildren; ++i)
+        {
+            const BVHNode &child = nodes[children[i]];
+            if (!child.leaf() && child.bounds.area() > largestArea)
+            {
+                largest = (i32)i;
+                largestArea = child.bounds.area();
+            }
+        }
+        if (largest < 0)
+        {
+            break;
+        }
+
+        u32 opened = children[largest];
+        children[largest] = opened + 1;
+        children[numChildren++] = nodes[opened].offset;
+    }
+
+    u32 childNodes[N];
+    for (u32 i = 0; i < numChildren; ++i)
+    {
+        const BVHNode &child = nodes[children[i]];
+        childNodes[i] = child.leaf() ? child.offset : this->_collapse(nodes, children[i]);
+    }
+
+    // The recursion may have moved the nodes.
+    WideBVHNode<N> &node = this->_nodes[nodeIndex];
+    for (u32 i = 0; i < N; ++i)
+    {
+        // The unused slots are masked out by numChildren in the traversal.
+        AABB bounds = i < numChildren ? nodes[children[i]].bounds : AABB();
+        node.minX[i] = bounds.min.x;
+        node.minY[i] = bounds.min.y;
+        node.minZ[i] = bounds.min.z;
+        node.maxX[i] = bounds.max.x;
+        node.maxY[i] = bounds.max.y;
+        node.maxZ[i] = bounds.max.z;
+        node.child[i] = i < numChildren ? childNodes[i] : 0;
+        node.count[i] = i < numChildren ? (u32)nodes[children[i]].count : 0;
+    }
+    node.numChildren = numChildren;
+
+    return nodeIndex;
+}
+
+template class WideBVH<4>;
+template class WideBVH<8>;
+
+CS6620_NAMESPACE_END
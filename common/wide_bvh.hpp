@@ -0,0 +1,286 @@
+/**
+ * \file wide_bvh.hpp
+ * \author lihw (lihw81@gmail.com)
+ * \changelog
+ * - 2026/10/17 initial check in
+ *
+ * The 4 or 8-ary BVH collapsed from a binary one, whose nodes test all
+ * their children against a ray at once with SIMD.
+ */
+
+#ifndef WIDE_BVH_HPP
+#define WIDE_BVH_HPP
+
+#include "common.h"
+
+#include <vector>
+
+#include "bvh.hpp"
+#include "packet.hpp"
+#include "stats.hpp"
+
+CS6620_NAMESPACE_BEGIN
+
+/**
+ * A node of the wide BVH with the bounds of its up to N children stored
+ * component by component, so they load straight into the lanes. The
+ * children are packed to the front. It isn't over-aligned as std::vector
+ * doesn't honor that before C++17, so the lanes are loaded unaligned.
+ */
+template <int N>
+struct WideBVHNode
+{
+    f32 minX[N], minY[N], minZ[N];
+    f32 maxX[N], maxY[N], maxZ[N];
+    u32 child[N];    /**< The child node, or the first primitive of a leaf. */
+    u32 count[N];    /**< The primitives of a leaf child. 0 for an interior one. */
+    u32 numChildren;
+};
+
+/**
+ * The N-ary BVH made by collapsing a binary BVH, i.e., pulling the
+ * grandchildren with the largest surface area up into their parent until
+ * it has N children. The leaves and the primitive order stay the same, so
+ * it refers to the primitives by the indices() of the binary BVH.
+ */
+template <int N>
+class WideBVH
+{
+public:
+    /**
+     * The traversal stack. Every visited node may postpone N - 1 children.
+     */
+    static const u32 STACK_SIZE = BVH::MAX_DEPTH * (N - 1) + 1;
+
+public:
+    /**
+     * Constructor.
+     */
+    explicit WideBVH();
+    /**
+     * Destructor.
+     */
+    ~WideBVH();
+    /**
+     * Collapse a binary BVH.
+     */
+    void build(const BVH &bvh) noexcept;
+    /**
+     * Walk the hierarchy and visit the leaves along the ray in front-to-back
+     * order of their entry distances.
+     * @see BVH::intersect()
+     */
+    template <typename F>
+    bool intersect(const Ray &ray, f32 &tmax, F &&intersectLeaf) const noexcept;
+    /**
+     * Walk the hierarchy until any leaf along the ray reports a hit.
+     * @see BVH::occluded()
+     */
+    template <typename F>
+    bool occluded(const Ray &ray, f32 tmax, F &&occludedLeaf) const noexcept;
+
+    u32 numNodes() const { return (u32)this->_nodes.size(); }
+
+private:
+    /**
+     * Recursively collapse the binary subtree at a node.
+     * @return the index of the created node.
+     */
+    u32 _collapse(const BVHNode *nodes, u32 binaryNode) noexcept;
+
+private:
+    std::vector<WideBVHNode<N>> _nodes;
+};
+
+template <int N>
+template <typename F>
+bool WideBVH<N>::intersect(const Ray &ray, f32 &tmax, F &&intersectLeaf) const noexcept
+{
+    typedef Lanes<f32, N> Scalar;
+
+    if (this->_nodes.empty())
+    {
+        return false;
+    }
+
+    const Scalar ox(ray.origin.x);
+    const Scalar oy(ray.origin.y);
+    const Scalar oz(ray.origin.z);
+    const Scalar ix(1.0f / ray.direction.x);
+    const Scalar iy(1.0f / ray.direction.y);
+    const Scalar iz(1.0f / ray.direction.z);
+    const Scalar zero(0.0f);
+
+    struct Entry
+    {
+        u32 child;
+        u32 count;
+        f32 tnear;
+    };
+    Entry stack[STACK_SIZE];
+    u32 top = 0;
+
+    stack[top++] = Entry{0, 0, 0.0f};
+
+    u32 visits = 0;
+    bool hit = false;
+
+    while (top > 0)
+    {
+        Entry entry = stack[--top];
+
+        // A closer hit may have been found since it was pushed.
+        if (entry.tnear > tmax)
+        {
+            continue;
+        }
+
+        if (entry.count > 0)
+        {
+            if (intersectLeaf(entry.child, entry.count, tmax))
+            {
+                hit = true;
+            }
+            continue;
+        }
+
+        const WideBVHNode<N> &node = this->_nodes[entry.child];
+        ++visits;
+
+        // The slab test of AABB::intersect() for all children at once. Min()
+        // and Max() pick the same operand as cy::Min() and cy::Max() do.
+        Scalar tx0 = (Scalar::load(node.minX) - ox) * ix;
+        Scalar tx1 = (Scalar::load(node.maxX) - ox) * ix;
+        Scalar ty0 = (Scalar::load(node.minY) - oy) * iy;
+        Scalar ty1 = (Scalar::load(node.maxY) - oy) * iy;
+        Scalar tz0 = (Scalar::load(node.minZ) - oz) * iz;
+        Scalar tz1 = (Scalar::load(node.maxZ) - oz) * iz;
+
+        Scalar tnear = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Min(tz0, tz1));
+        Scalar tfar = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Max(tz0, tz1));
+
+        u32 bits = ((tnear <= tfar) & (tfar >= zero) & (tnear <= Scalar(tmax))).bits();
+        bits &= (1u << node.numChildren) - 1;
+        if (bits == 0)
+        {
+            continue;
+        }
+
+        alignas(32) f32 tnears[N];
+        tnear.store(tnears);
+
+        // Push the hit children sorted by their entry distances with the
+        // farthest at the bottom, so the nearest is popped first.
+        u32 first = top;
+        while (bits != 0)
+        {
+            u32 i = 0;
+            while ((bits >> i & 1) == 0)
+            {
+                ++i;
+            }
+            bits &= bits - 1;
+
+            Entry child = Entry{node.child[i], node.count[i], tnears[i]};
+            u32 j = top++;
+            while (j > first && stack[j - 1].tnear < child.tnear)
+            {
+                stack[j] = stack[j - 1];
+                --j;
+            }
+            stack[j] = child;
+        }
+    }
+
+    CS6620_STATS_ADD(NODE_VISITS, visits);
+
+    return hit;
+}
+
+template <int N>
+template <typename F>
+bool WideBVH<N>::occluded(const Ray &ray, f32 tmax, F &&occludedLeaf) const noexcept
+{
+    typedef Lanes<f32, N> Scalar;
+
+    if (this->_nodes.empty())
+    {
+        return false;
+    }
+
+    const Scalar ox(ray.origin.x);
+    const Scalar oy(ray.origin.y);
+    const Scalar oz(ray.origin.z);
+    const Scalar ix(1.0f / ray.direction.x);
+    const Scalar iy(1.0f / ray.direction.y);
+    const Scalar iz(1.0f / ray.direction.z);
+    const Scalar zero(0.0f);
+    const Scalar limit(tmax);
+
+    struct Entry
+    {
+        u32 child;
+        u32 count;
+    };
+    Entry stack[STACK_SIZE];
+    u32 top = 0;
+
+    stack[top++] = Entry{0, 0};
+
+    u32 visits = 0;
+    bool hit = false;
+
+    while (top > 0)
+    {
+        Entry entry = stack[--top];
+
+        if (entry.count > 0)
+        {
+            if (occludedLeaf(entry.child, entry.count, tmax))
+            {
+                hit = true;
+                break;
+            }
+            continue;
+        }
+
+        const WideBVHNode<N> &node = this->_nodes[entry.child];
+        ++visits;
+
+        Scalar tx0 = (Scalar::load(node.minX) - ox) * ix;
+        Scalar tx1 = (Scalar::load(node.maxX) - ox) * ix;
+        Scalar ty0 = (Scalar::load(node.minY) - oy) * iy;
+        Scalar ty1 = (Scalar::load(node.maxY) - oy) * iy;
+        Scalar tz0 = (Scalar::load(node.minZ) - oz) * iz;
+        Scalar tz1 = (Scalar::load(node.maxZ) - oz) * iz;
+
+        Scalar tnear = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Min(tz0, tz1));
+        Scalar tfar = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Max(tz0, tz1));
+
+        u32 bits = ((tnear <= tfar) & (tfar >= zero) & (tnear <= limit)).bits();
+        bits &= (1u << node.numChildren) - 1;
+
+        // Any hit ends the walk, so the hit children are pushed as they are
+        // without sorting them by their entry distances.
+        while (bits != 0)
+        {
+            u32 i = 0;
+            while ((bits >> i & 1) == 0)
+            {
+                ++i;
+            }
+            bits &= bits - 1;
+
+            stack[top++] = Entry{node.child[i], node.count[i]};
+        }
+    }
+
+    CS6620_STATS_ADD(NODE_VISITS, visits);
+
+    return hit;
+}
+
+CS6620_NAMESPACE_END
+
+
+#endif // !WIDE_BVH_HPP
@@ -12,50 +12,231 @@
 #include "../common/view.hpp"
 #include "../common/sampler.hpp"
 #include "../common/ray.hpp"
+#include "../common/renderer.hpp"
+#include "../common/profiler.hpp"
+#include "../common/stats.hpp"
+#include "../common/thread_pool.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
 
 int main(int argc, const char *argv[])
 {
+    // Parse the command line. --threads N sets the number of threads that
+    // build the BVHs and render, by default one per hardware thread.
+    // --progressive renders one sample per pixel a pass and dumps the
+    // preview after every --dump-passes N passes or --dump-seconds T
+    // seconds. --adaptive E samples each pixel until the error of its
+    // luminance drops below E and dumps the sample counts as a heatmap.
+    // --sampler naive|sobol|halton picks the sample positions. --scene F
+    // loads another scene, either XML or a snapshot, and --save-snapshot F
+    // writes the prepared scene to a snapshot.
+    // --bvh-cache D keeps the built BVHs in the directory D for later runs.
+    // --bvh-width 2|4|8 traverses the scene BVH as a binary, 4 or 8-ary one.
+    // --bvh-builder sah|lbvh|lbvh-treelet builds it with the binned SAH or
+    // as a linear BVH, optionally with its treelets reordered.
+    // --tonemap clamp|reinhard|aces and --exposure X map the colors to the
+    // output, which is sRGB encoded unless --linear. --output F writes the
+    // result to F, a .png or .ppm file, or a .pfm or half-float .exr file of
+    // the linear colors, and --png-compression
+    // stored|fast|best sets the compression of the final .png. --stream-rows
+    // N holds only N rows of the image in memory and streams them to the
+    // output .ppm as they're done.
+    u32 numThreads = 0;
+    bool progressive = false;
+    u32 dumpPasses = 0;
+    f32 dumpSeconds = 0.0f;
+    f32 adaptiveThreshold = 0.0f;
+    const char *samplerName = "naive";
+    const char *sceneFile = "../data/project1/scene.xml";
+    const char *snapshotFile = nullptr;
+    const char *bvhCacheDirectory = nullptr;
+    u32 bvhWidth = 2;
+    cs6620::BVHBuilder bvhBuilder = cs6620::BVHBuilder::SAH;
+    cs6620::ToneMapping toneMapping;
+    const char *outputFile = "../data/project1/result.ppm";
+    cs6620::PNGCompression pngCompression = cs6620::PNGCompression::BEST;
+    u32 streamRows = 0;
+    for (i32 i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            numThreads = (u32)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--progressive") == 0)
+        {
+            progressive = true;
+        }
+        else if (strcmp(argv[i], "--dump-passes") == 0 && i + 1 < argc)
+        {
+            dumpPasses = (u32)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--dump-seconds") == 0 && i + 1 < argc)
+        {
+            dumpSeconds = (f32)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--adaptive") == 0 && i + 1 < argc)
+        {
+            adaptiveThreshold = (f32)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--sampler") == 0 && i + 1 < argc)
+        {
+            samplerName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+        {
+            sceneFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save-snapshot") == 0 && i + 1 < argc)
+        {
+            snapshotFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--bvh-cache") == 0 && i + 1 < argc)
+        {
+            bvhCacheDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--bvh-width") == 0 && i + 1 < argc)
+        {
+            bvhWidth = (u32)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bvh-builder") == 0 && i + 1 < argc)
+        {
+            if (!cs6620::ParseBVHBuilder(argv[++i], bvhBuilder))
+            {
+                LOG(ERROR) << "Unknown BVH builder '" << argv[i] << "'.";
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--tonemap") == 0 && i + 1 < argc)
+        {
+            if (!cs6620::ParseToneOperator(argv[++i], toneMapping.op))
+            {
+                LOG(ERROR) << "Unknown tone operator '" << argv[i] << "'.";
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--exposure") == 0 && i + 1 < argc)
+        {
+            toneMapping.exposure = (f32)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--linear") == 0)
+        {
+            toneMapping.srgb = false;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            outputFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--png-compression") == 0 && i + 1 < argc)
+        {
+            if (!cs6620::ParsePNGCompression(argv[++i], pngCompression))
+            {
+                LOG(ERROR) << "Unknown PNG compression '" << argv[i] << "'.";
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--stream-rows") == 0 && i + 1 < argc)
+        {
+            streamRows = (u32)atoi(argv[++i]);
+        }
+    }
+
+    if (streamRows > 0 && (progressive || adaptiveThreshold > 0.0f))
+    {
+        LOG(ERROR) << "--stream-rows works with neither --progressive nor --adaptive.";
+        return -1;
+    }
+
     // Load scene.
     cs6620::Scene scene;
-    if (!scene.load("../data/project1/scene.xml"))
+    if (!scene.load(sceneFile))
     {
         return -1;
     }
 
-    scene.prepare();
+    cs6620::Arena::Stats arenaStats = scene.arenaStats();
+    LOG(INFO) << "Scene nodes take " << arenaStats.allocations << " allocations of " << arenaStats.bytes
+        << " bytes in " << arenaStats.blocks << " heap blocks.";
+
+    // The same threads build the BVHs and then render.
+    cs6620::ThreadPool pool(numThreads);
+
+    scene.prepare(bvhCacheDirectory, bvhWidth, bvhBuilder, &pool);
+
+    if (snapshotFile != nullptr && !scene.save(snapshotFile))
+    {
+        return -1;
+    }
 
     // Create the preview view.
-    cs6620::View view(scene.camera->width, scene.camera->height);
+    cs6620::View view(scene.camera->width, scene.camera->height, streamRows);
+    view.setToneMapping(toneMapping);
+    view.setPNGCompression(cs6620::PNGCompression::FAST, pngCompression);
         
-    const u32 N = 16;
-    cs6620::NaiveSampler sampler(N);
-    vec2 *samples = sampler.samples();
+    // The adaptive sampling may spend more samples on the noisy pixels.
+    const u32 N = adaptiveThreshold > 0.0f ? 64 : 16;
+    std::unique_ptr<cs6620::Sampler> sampler;
+    if (strcmp(samplerName, "sobol") == 0)
+    {
+        sampler.reset(new cs6620::SobolSampler(N));
+    }
+    else if (strcmp(samplerName, "halton") == 0)
+    {
+        sampler.reset(new cs6620::HaltonSampler(N));
+    }
+    else
+    {
+        sampler.reset(new cs6620::NaiveSampler(N));
+    }
 
-    for (u32 i = 0; i < scene.camera->height; ++i)
-    for (u32 j = 0; j < scene.camera->width; ++j)
+    cs6620::Renderer renderer(&scene, &view, sampler.get(), &pool);
+
+    LOG(INFO) << "Rendering with " << renderer.numThreads() << " threads.";
+
+    cs6620::Stats::reset();
+    cs6620::Timer timer;
+
+    if (adaptiveThreshold > 0.0f)
     {
-        vec3 color = vec3(0, 0, 0);
-        vec3 ray = vec3(0, 0, 0);
-        for (u32 s = 0; s < N; ++s)
-        {
-            f32 x = (f32)j + samples[s].x;
-            f32 y = (f32)i + samples[s].y;
+        u64 numSamples = renderer.renderAdaptive(4, adaptiveThreshold);
 
-            cs6620::Ray ray = scene.camera->unproject(x, y);
+        LOG(INFO) << "Adaptive sampling takes " << (f32)numSamples / (f32)(view.width() * view.height())
+            << " samples per pixel on average.";
 
-            color += scene.shade(ray);
+        if (!view.dumpSampleCounts("../data/project1/samples.ppm"))
+        {
+            return -1;
+        }
+    }
+    else if (progressive)
+    {
+        if (!renderer.renderProgressive(0, dumpPasses, dumpSeconds, outputFile))
+        {
+            return -1;
+        }
+    }
+    else if (streamRows > 0)
+    {
+        if (!renderer.renderStreaming(outputFile))
+        {
+            return -1;
         }
-
-        view.write(vec2u(j, i), color / (f32)N);
     }
+    else
+    {
+        renderer.render();
+    }
+
+    cs6620::Stats::report(timer.elapsed());
 
-    if (!view.dump("../data/project1/result.ppm"))
+    if (streamRows == 0 && !view.dump(outputFile))
     {
         return -1;
     }
     else
     {
-        LOG(INFO) << "Render succeeds. The result image dumps to data/project1/result.ppm";
+        LOG(INFO) << "Render succeeds. The result image dumps to " << outputFile;
     }
 
     return 0;